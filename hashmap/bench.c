@@ -0,0 +1,1749 @@
+/**
+ * bench.c
+ *
+ * benchmarks for the hashmap.
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <malloc.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hashmap.h"
+#include "frozen.h"
+#include "hashset.h"
+#include "intmap.h"
+#include "lru.h"
+#include "shardmap.h"
+
+
+/* number of keys per run */
+#define KEY_COUNT       (1 << 20)
+
+/* bindings in flooding runs, and the share of the
+ * table their home slots are crowded into */
+#define FLOOD_COUNT     (1 << 16)
+#define FLOOD_SHARE     256
+
+/* live keys and remove and reinsert cycles of churning runs */
+#define CHURN_KEYS      100
+#define CHURN_CYCLES    (1 << 20)
+
+/* hashmaps and bindings per hashmap in runs of many tiny hashmaps */
+#define TINY_MAPS       (1 << 14)
+#define TINY_KEYS       4
+
+/* distinct keys and accesses of cache traces */
+#define TRACE_KEYS      (1 << 20)
+#define TRACE_LENGTH    (1 << 22)
+
+
+typedef struct {
+    /* name to report */
+    const char *name;
+    /* hash function */
+    HashFunc hash;
+
+} hash_function;
+
+
+static const hash_function hash_functions[] = {
+    { "djb2",    map_hash_djb2    },
+    { "wyhash",  map_hash_wyhash  },
+    { "xxh64",   map_hash_xxh64   },
+    { "siphash", map_hash_siphash },
+};
+
+static const size_t key_lengths[] = { 8, 16, 32, 64, 256 };
+
+
+typedef struct {
+    /* name to report */
+    const char *name;
+    /* mode flags */
+    int flags;
+
+} sizing_mode;
+
+
+static const sizing_mode sizing_modes[] = {
+    { "prime",     0             },
+    { "pow2",      MAP_POW2      },
+    { "fibonacci", MAP_FIBONACCI },
+};
+
+
+typedef struct {
+    /* name to report */
+    const char *name;
+    /* mode flags */
+    int flags;
+
+} probing_mode;
+
+
+static const probing_mode probing_modes[] = {
+    { "linear",     0              },
+    { "robinhood",  MAP_ROBIN_HOOD },
+    { "quadratic",  MAP_QUADRATIC  },
+    { "triangular", MAP_TRIANGULAR },
+};
+
+
+/* seconds since arbitrary point in time */
+static double
+now (void)
+{
+
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+
+}
+
+
+/* bytes currently allocated on the heap, counting mapped chunks */
+static size_t
+heap_memory (void)
+{
+
+    struct mallinfo2 info = mallinfo2 ();
+
+    return info.uordblks + info.hblkhd;
+
+}
+
+
+/* xorshift random numbers from given state */
+static uint64_t
+xorshift (uint64_t *state)
+{
+
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+
+}
+
+
+/* xorshift random numbers */
+static uint64_t
+rnd (void)
+{
+
+    static uint64_t state = 88172645463325252ull;
+
+    return xorshift (&state);
+
+}
+
+
+/* trace of given length of key indices below given count, drawn
+ * from a zipf distribution of exponent 1 with index 0 the hottest */
+static size_t *
+make_zipf_trace (size_t count, size_t length)
+{
+
+    size_t i, lo, hi, mid;
+
+    double u, sum;
+
+    double *cdf = malloc (count * sizeof (double));
+    size_t *trace = malloc (length * sizeof (size_t));
+
+    for (i = 0, sum = 0; i < count; ++i) {
+        sum += 1.0 / (i + 1);
+        cdf[i] = sum;
+    }
+
+    for (i = 0; i < length; ++i) {
+
+        u = (rnd () >> 11) / 9007199254740992.0 * sum;
+
+        // first index whose cumulative weight reaches u
+        for (lo = 0, hi = count - 1; lo < hi; ) {
+            mid = lo + (hi - lo) / 2;
+
+            if (cdf[mid] < u)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        trace[i] = lo;
+
+    }
+
+    free (cdf);
+
+    return trace;
+
+}
+
+
+/* allocate count distinct random keys of given length */
+static Key *
+make_keys (size_t count, size_t len)
+{
+
+    size_t i, j;
+
+    Key *keys = malloc (count * sizeof (Key));
+
+    for (i = 0; i < count; ++i) {
+
+        keys[i] = malloc (len + 1);
+
+        // unique prefix, random printable remainder
+        snprintf (keys[i], len + 1, "%zx", i);
+
+        for (j = strlen (keys[i]); j < len; ++j)
+            keys[i][j] = 'a' + rnd () % 26;
+
+        keys[i][len] = '\0';
+    }
+
+    return keys;
+
+}
+
+
+/* delete keys */
+static void
+free_keys (Key *keys, size_t count)
+{
+
+    size_t i;
+
+    for (i = 0; i < count; ++i)
+        free (keys[i]);
+
+    free (keys);
+
+}
+
+
+/* hash throughput by key length */
+static void
+bench_hash (void)
+{
+
+    size_t i, f, l;
+
+    uint64_t sink = 0;
+
+    double start, elapsed;
+
+    Key *keys;
+
+    printf ("%-8s %6s %12s %12s\n", "hash", "keylen", "Mkeys/s", "GB/s");
+
+    for (l = 0; l < sizeof (key_lengths) / sizeof (*key_lengths); ++l) {
+
+        keys = make_keys (KEY_COUNT, key_lengths[l]);
+
+        for (f = 0; f < sizeof (hash_functions) / sizeof (*hash_functions); ++f) {
+
+            start = now ();
+
+            for (i = 0; i < KEY_COUNT; ++i)
+                sink += hash_functions[f].hash (keys[i], key_lengths[l], 0);
+
+            elapsed = now () - start;
+
+            printf ("%-8s %6zu %12.1f %12.2f\n", hash_functions[f].name, key_lengths[l],
+                    KEY_COUNT / elapsed / 1e6, KEY_COUNT * key_lengths[l] / elapsed / 1e9);
+        }
+
+        free_keys (keys, KEY_COUNT);
+    }
+
+    // keep hashing from being optimized away
+    if (sink == 42)
+        printf ("\n");
+
+}
+
+
+/* hashmap insert and lookup throughput by hash function and key length */
+static void
+bench_map (void)
+{
+
+    size_t i, f, l;
+
+    double start, insert, lookup;
+
+    Hashmap h;
+    Any value;
+    Key *keys;
+
+    printf ("%-8s %6s %12s %12s\n", "hash", "keylen", "insert Mops", "lookup Mops");
+
+    for (l = 0; l < sizeof (key_lengths) / sizeof (*key_lengths); ++l) {
+
+        keys = make_keys (KEY_COUNT, key_lengths[l]);
+
+        for (f = 0; f < sizeof (hash_functions) / sizeof (*hash_functions); ++f) {
+
+            map_init_with_hash (&h, 0, hash_functions[f].hash, 0);
+
+            start = now ();
+
+            for (i = 0; i < KEY_COUNT; ++i)
+                map_insert (h, keys[i], keys[i]);
+
+            insert = now () - start;
+            start = now ();
+
+            for (i = 0; i < KEY_COUNT; ++i)
+                map_lookup (h, keys[(i * 7919) % KEY_COUNT], &value);
+
+            lookup = now () - start;
+
+            printf ("%-8s %6zu %12.1f %12.1f\n", hash_functions[f].name, key_lengths[l],
+                    KEY_COUNT / insert / 1e6, KEY_COUNT / lookup / 1e6);
+
+            map_free (h);
+        }
+
+        free_keys (keys, KEY_COUNT);
+    }
+
+}
+
+
+/* hashmap insert and lookup throughput by table sizing mode */
+static void
+bench_sizing (void)
+{
+
+    size_t i, f, m;
+
+    double start, insert, lookup;
+
+    Hashmap h;
+    Any value;
+    Key *keys;
+
+    keys = make_keys (KEY_COUNT, 16);
+
+    printf ("%-8s %-10s %12s %12s\n", "hash", "sizing", "insert Mops", "lookup Mops");
+
+    for (f = 0; f < sizeof (hash_functions) / sizeof (*hash_functions); ++f) {
+
+        for (m = 0; m < sizeof (sizing_modes) / sizeof (*sizing_modes); ++m) {
+
+            map_init_with_hash (&h, sizing_modes[m].flags, hash_functions[f].hash, 0);
+
+            start = now ();
+
+            for (i = 0; i < KEY_COUNT; ++i)
+                map_insert (h, keys[i], keys[i]);
+
+            insert = now () - start;
+            start = now ();
+
+            for (i = 0; i < KEY_COUNT; ++i)
+                map_lookup (h, keys[(i * 7919) % KEY_COUNT], &value);
+
+            lookup = now () - start;
+
+            printf ("%-8s %-10s %12.1f %12.1f\n", hash_functions[f].name, sizing_modes[m].name,
+                    KEY_COUNT / insert / 1e6, KEY_COUNT / lookup / 1e6);
+
+            map_free (h);
+        }
+    }
+
+    free_keys (keys, KEY_COUNT);
+
+}
+
+
+/* wyhash with the low bits of the home slot cleared, so
+ * that keys pile up on every 8th slot of a pow2 table */
+static uint64_t
+clustered_hash (const void *key, size_t len, uint64_t seed)
+{
+
+    return map_hash_wyhash (key, len, seed) & ~((uint64_t) 0x7 << 7);
+
+}
+
+
+/* hashmap throughput and table size by probing mode on clustered keys */
+static void
+bench_probing (void)
+{
+
+    size_t i, m;
+
+    double start, insert, lookup;
+
+    Hashmap h;
+    MapStats stats;
+    Any value;
+    Key *keys;
+
+    keys = make_keys (KEY_COUNT, 16);
+
+    printf ("%-10s %12s %12s %12s %12s\n", "probing", "insert Mops", "lookup Mops", "size", "max run");
+
+    for (m = 0; m < sizeof (probing_modes) / sizeof (*probing_modes); ++m) {
+
+        map_init_with_hash (&h, probing_modes[m].flags | MAP_POW2, clustered_hash, 0);
+
+        start = now ();
+
+        for (i = 0; i < KEY_COUNT; ++i)
+            map_insert (h, keys[i], keys[i]);
+
+        insert = now () - start;
+        start = now ();
+
+        for (i = 0; i < KEY_COUNT; ++i)
+            map_lookup (h, keys[(i * 7919) % KEY_COUNT], &value);
+
+        lookup = now () - start;
+
+        map_stats (h, &stats);
+
+        printf ("%-10s %12.1f %12.1f %12zu %12zu\n", probing_modes[m].name,
+                KEY_COUNT / insert / 1e6, KEY_COUNT / lookup / 1e6, stats.size, stats.max_run);
+
+        map_free (h);
+    }
+
+    free_keys (keys, KEY_COUNT);
+
+}
+
+
+/* allocate count keys of given length whose home slots under wyhash with
+ * seed 0 lie in the first share of a table of given size, as an attacker
+ * knowing the hash function and seed of a hashmap would choose them */
+static Key *
+make_flood_keys (size_t count, size_t len, size_t size)
+{
+
+    size_t i, j, n;
+
+    Key *keys = malloc (count * sizeof (Key));
+
+    for (i = 0, n = 0; n < count; ++i) {
+
+        keys[n] = malloc (len + 1);
+
+        snprintf (keys[n], len + 1, "%zx", i);
+
+        for (j = strlen (keys[n]); j < len; ++j)
+            keys[n][j] = 'a' + rnd () % 26;
+
+        keys[n][len] = '\0';
+
+        // keep keys crowding the start of the table
+        if ((map_hash_wyhash (keys[n], len, 0) >> 7) % size < size / FLOOD_SHARE)
+            ++n;
+        else
+            free (keys[n]);
+    }
+
+    return keys;
+
+}
+
+
+/* allocate count binary keys of 16 bytes whose words read by wyhash for its
+ * final multiplication cancel its public secret, which would wipe out the
+ * seed if the product replaced its factors, and which vary only in the rest */
+static Key *
+make_crafted_keys (size_t count)
+{
+
+    size_t i;
+
+    uint32_t w[4];
+
+    Key *keys = malloc (count * sizeof (Key));
+
+    for (i = 0; i < count; ++i) {
+
+        keys[i] = malloc (17);
+
+        w[0] = 0x8bb84b93;
+        w[1] = (uint32_t) i;
+        w[2] = 0x962eacc9;
+        w[3] = (uint32_t) rnd ();
+
+        memcpy (keys[i], w, 16);
+        keys[i][16] = '\0';
+    }
+
+    return keys;
+
+}
+
+
+/* insert throughput of random and flooding keys with a fixed
+ * seed known to the attacker against random seeds per hashmap */
+static void
+bench_flood (void)
+{
+
+    size_t i, m, k;
+
+    double start, elapsed[3];
+
+    Hashmap h;
+    MapStats stats;
+    Key *keys[3];
+
+    static const char *seeds[] = { "wyhash, seed 0", "wyhash, random", "siphash, random" };
+
+    // table size of the reserved hashmaps
+    map_init (&h);
+    map_reserve (h, FLOOD_COUNT);
+    map_stats (h, &stats);
+    map_free (h);
+
+    keys[0] = make_keys (FLOOD_COUNT, 16);
+    keys[1] = make_flood_keys (FLOOD_COUNT, 16, stats.size);
+    keys[2] = make_crafted_keys (FLOOD_COUNT);
+
+    printf ("%-16s %12s %12s %12s\n", "seed", "random Mops", "flood Mops", "crafted Mops");
+
+    for (m = 0; m < sizeof (seeds) / sizeof (*seeds); ++m) {
+
+        for (k = 0; k < 3; ++k) {
+
+            if (m == 0)
+                map_init_with_hash (&h, 0, map_hash_wyhash, 0);
+            else
+                map_init_with_flags (&h, m == 2 ? MAP_SIPHASH : 0);
+
+            map_reserve (h, FLOOD_COUNT);
+
+            start = now ();
+
+            // crafted keys may hold NUL bytes
+            for (i = 0; i < FLOOD_COUNT; ++i)
+                map_insert_n (h, keys[k][i], 16, keys[k][i]);
+
+            elapsed[k] = now () - start;
+
+            map_free (h);
+        }
+
+        printf ("%-16s %12.2f %12.2f %12.2f\n", seeds[m], FLOOD_COUNT / elapsed[0] / 1e6,
+                FLOOD_COUNT / elapsed[1] / 1e6, FLOOD_COUNT / elapsed[2] / 1e6);
+    }
+
+    free_keys (keys[0], FLOOD_COUNT);
+    free_keys (keys[1], FLOOD_COUNT);
+    free_keys (keys[2], FLOOD_COUNT);
+
+}
+
+
+/* wyhash keeping only its low bits, crowding all keys into few home slots */
+static uint64_t
+crowded_hash (const void *key, size_t len, uint64_t seed)
+{
+
+    return map_hash_wyhash (key, len, seed) & 0x3ff;
+
+}
+
+
+typedef struct {
+    /* name to report */
+    const char *name;
+    /* mode flags */
+    int flags;
+    /* hash function, NULL for default */
+    HashFunc hash;
+
+} churn_mode;
+
+
+static const churn_mode churn_modes[] = {
+    { "compact",   MAP_COMPACT | MAP_POW2,          crowded_hash },
+    { "owned",     MAP_OWN_KEYS,                    NULL         },
+    { "owned rh",  MAP_OWN_KEYS | MAP_ROBIN_HOOD,   NULL         },
+    { "owned inc", MAP_OWN_KEYS | MAP_INCREMENTAL,  NULL         },
+    { "owned sm",  MAP_OWN_KEYS | MAP_SMALL,        NULL         },
+};
+
+
+/* heap growth of hashmaps churned by removing and reinserting keys, whose
+ * removed entries in compact mode and removed owned keys must be purged
+ * instead of piling up, also when robin hood removal leaves no deleted slots */
+static void
+bench_churn (void)
+{
+
+    size_t i, m, before, after;
+
+    double start, elapsed;
+
+    Hashmap h;
+    MapStats stats;
+    Key *keys;
+
+    keys = make_keys (CHURN_KEYS, 16);
+
+    printf ("%-10s %12s %12s %12s %12s\n", "mode", "cycle Mops", "heap bytes", "size", "deleted");
+
+    for (m = 0; m < sizeof (churn_modes) / sizeof (*churn_modes); ++m) {
+
+        map_init_with_hash (&h, churn_modes[m].flags, churn_modes[m].hash, 0);
+
+        for (i = 0; i < CHURN_KEYS; ++i)
+            map_insert (h, keys[i], keys[i]);
+
+        before = heap_memory ();
+        start = now ();
+
+        for (i = 0; i < CHURN_CYCLES; ++i) {
+            map_remove (h, keys[i % CHURN_KEYS]);
+            map_insert (h, keys[i % CHURN_KEYS], keys[i % CHURN_KEYS]);
+        }
+
+        elapsed = now () - start;
+        after = heap_memory ();
+
+        map_stats (h, &stats);
+
+        printf ("%-10s %12.1f %12zu %12zu %12zu\n", churn_modes[m].name, CHURN_CYCLES / elapsed / 1e6,
+                after > before ? after - before : 0, stats.size, stats.deleted);
+
+        map_free (h);
+
+        // removed entries or keys outliving purges grow the heap with every cycle
+        if (after > before + CHURN_CYCLES) {
+            fprintf (stderr, "churn: %s hashmap grows without bound\n", churn_modes[m].name);
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    free_keys (keys, CHURN_KEYS);
+
+}
+
+
+/* hashmap iteration over few bindings in a table reserved for many,
+ * with bindings in the slots and in a dense array in compact mode */
+static void
+bench_compact (void)
+{
+
+    size_t i, n, m;
+
+    double start, insert, iterate;
+
+    Hashmap h;
+    Iterator it;
+    Key key;
+    Any value;
+    Key *keys;
+
+    static const int flags[] = { 0, MAP_COMPACT };
+
+    keys = make_keys (KEY_COUNT, 16);
+
+    printf ("%-8s %12s %12s %12s\n", "layout", "insert Mops", "bindings", "iterate ms");
+
+    for (m = 0; m < sizeof (flags) / sizeof (*flags); ++m) {
+
+        map_init_with_flags (&h, flags[m]);
+        map_reserve (h, KEY_COUNT);
+
+        start = now ();
+
+        for (i = 0; i < KEY_COUNT / 100; ++i)
+            map_insert (h, keys[i], keys[i]);
+
+        insert = now () - start;
+        start = now ();
+
+        map_iter_init (&it, h);
+
+        for (n = 0; map_iter_next (it, &key, &value) == MAP_OK; ++n);
+
+        map_iter_free (it);
+
+        iterate = now () - start;
+
+        printf ("%-8s %12.1f %12zu %12.2f\n", flags[m] ? "compact" : "slots",
+                KEY_COUNT / 100 / insert / 1e6, n, iterate * 1e3);
+
+        map_free (h);
+    }
+
+    free_keys (keys, KEY_COUNT);
+
+}
+
+
+/* upsert callback counting occurrences */
+static void
+count_one (Any *value, int inserted, void *ctx)
+{
+
+    (void) inserted;
+    (void) ctx;
+
+    *value = (Any) ((uintptr_t) *value + 1);
+
+}
+
+
+/* counting occurrences by lookup and insert against entry and upsert */
+static void
+bench_upsert (void)
+{
+
+    size_t i, m;
+
+    int inserted;
+
+    double start, elapsed;
+
+    Hashmap h;
+    Any value, *slot;
+    Key *keys, *stream;
+
+    static const char *methods[] = { "lookup+insert", "entry", "upsert" };
+
+    keys = make_keys (KEY_COUNT / 16, 16);
+    stream = malloc (KEY_COUNT * sizeof (Key));
+
+    // every key occurs 16 times on average
+    for (i = 0; i < KEY_COUNT; ++i)
+        stream[i] = keys[rnd () % (KEY_COUNT / 16)];
+
+    printf ("%-14s %12s\n", "method", "count Mops");
+
+    for (m = 0; m < sizeof (methods) / sizeof (*methods); ++m) {
+
+        map_init (&h);
+
+        start = now ();
+
+        for (i = 0; i < KEY_COUNT; ++i) {
+            if (m == 0) {
+                if (map_lookup (h, stream[i], &value) != MAP_OK)
+                    value = NULL;
+
+                map_insert (h, stream[i], (Any) ((uintptr_t) value + 1));
+            } else if (m == 1) {
+                map_entry (h, stream[i], &slot, &inserted);
+                *slot = (Any) ((uintptr_t) *slot + 1);
+            } else {
+                map_upsert (h, stream[i], count_one, NULL);
+            }
+        }
+
+        elapsed = now () - start;
+
+        printf ("%-14s %12.1f\n", methods[m], KEY_COUNT / elapsed / 1e6);
+
+        map_free (h);
+    }
+
+    free (stream);
+    free_keys (keys, KEY_COUNT / 16);
+
+}
+
+
+/* memory and throughput of many tiny hashmaps with bindings held
+ * inline against hashmaps with a table, all kept alive so that
+ * the heap grows by what the hashmaps of each mode hold */
+static void
+bench_tiny (void)
+{
+
+    size_t i, j, m, memory;
+
+    double start, insert, lookup;
+
+    Any value;
+    Key *keys;
+    Hashmap *maps[2];
+
+    static const int flags[] = { MAP_SMALL, 0 };
+
+    keys = make_keys (TINY_MAPS * TINY_KEYS, 16);
+
+    printf ("%-8s %12s %12s %12s\n", "mode", "bytes/map", "insert Mops", "lookup Mops");
+
+    for (m = 0; m < sizeof (flags) / sizeof (*flags); ++m) {
+
+        maps[m] = malloc (TINY_MAPS * sizeof (Hashmap));
+
+        memory = heap_memory ();
+        start = now ();
+
+        for (i = 0; i < TINY_MAPS; ++i) {
+
+            map_init_with_flags (&maps[m][i], flags[m]);
+
+            for (j = 0; j < TINY_KEYS; ++j)
+                map_insert (maps[m][i], keys[i * TINY_KEYS + j], keys[i]);
+
+        }
+
+        insert = now () - start;
+        memory = heap_memory () - memory;
+        start = now ();
+
+        for (i = 0; i < TINY_MAPS; ++i) {
+
+            for (j = 0; j < TINY_KEYS; ++j)
+                map_lookup (maps[m][(i * 7919) % TINY_MAPS], keys[(i * 7919) % TINY_MAPS * TINY_KEYS + j], &value);
+
+        }
+
+        lookup = now () - start;
+
+        printf ("%-8s %12zu %12.1f %12.1f\n", flags[m] ? "small" : "table", memory / TINY_MAPS,
+                TINY_MAPS * TINY_KEYS / insert / 1e6, TINY_MAPS * TINY_KEYS / lookup / 1e6);
+    }
+
+    for (m = 0; m < sizeof (flags) / sizeof (*flags); ++m) {
+
+        for (i = 0; i < TINY_MAPS; ++i)
+            map_free (maps[m][i]);
+
+        free (maps[m]);
+    }
+
+    free_keys (keys, TINY_MAPS * TINY_KEYS);
+
+}
+
+
+/* worst case insert latency with and without incremental resize */
+static void
+bench_latency (void)
+{
+
+    size_t i, m;
+
+    double start, elapsed, latency, total;
+
+    Hashmap h;
+    Key *keys;
+
+    static const sizing_mode modes[] = {
+        { "resize",      0               },
+        { "incremental", MAP_INCREMENTAL },
+    };
+
+    keys = make_keys (4 * KEY_COUNT, 16);
+
+    printf ("%-12s %12s %12s\n", "mode", "insert Mops", "max us");
+
+    for (m = 0; m < sizeof (modes) / sizeof (*modes); ++m) {
+
+        map_init_with_flags (&h, modes[m].flags);
+
+        latency = 0;
+        total = now ();
+
+        for (i = 0; i < 4 * KEY_COUNT; ++i) {
+
+            start = now ();
+            map_insert (h, keys[i], keys[i]);
+            elapsed = now () - start;
+
+            if (elapsed > latency)
+                latency = elapsed;
+        }
+
+        total = now () - total;
+
+        printf ("%-12s %12.1f %12.1f\n", modes[m].name, 4 * KEY_COUNT / total / 1e6, latency * 1e6);
+
+        map_free (h);
+    }
+
+    free_keys (keys, 4 * KEY_COUNT);
+
+}
+
+
+/* integer ids formatted as string keys against integer keyed hashmap */
+static void
+bench_intmap (void)
+{
+
+    size_t i;
+
+    double start, insert, lookup;
+
+    Hashmap h;
+    Intmap im;
+    Any value;
+    Key *keys;
+
+    uint64_t *ids = malloc (KEY_COUNT * sizeof (uint64_t));
+
+    keys = malloc (KEY_COUNT * sizeof (Key));
+
+    for (i = 0; i < KEY_COUNT; ++i) {
+
+        ids[i] = rnd ();
+
+        keys[i] = malloc (21);
+        snprintf (keys[i], 21, "%llu", (unsigned long long) ids[i]);
+
+    }
+
+    printf ("%-8s %12s %12s\n", "map", "insert Mops", "lookup Mops");
+
+    map_init (&h);
+
+    start = now ();
+
+    for (i = 0; i < KEY_COUNT; ++i)
+        map_insert (h, keys[i], keys[i]);
+
+    insert = now () - start;
+    start = now ();
+
+    for (i = 0; i < KEY_COUNT; ++i)
+        map_lookup (h, keys[(i * 7919) % KEY_COUNT], &value);
+
+    lookup = now () - start;
+
+    printf ("%-8s %12.1f %12.1f\n", "string", KEY_COUNT / insert / 1e6, KEY_COUNT / lookup / 1e6);
+
+    map_free (h);
+
+    intmap_init (&im);
+
+    start = now ();
+
+    for (i = 0; i < KEY_COUNT; ++i)
+        intmap_insert (im, ids[i], keys[i]);
+
+    insert = now () - start;
+    start = now ();
+
+    for (i = 0; i < KEY_COUNT; ++i)
+        intmap_lookup (im, ids[(i * 7919) % KEY_COUNT], &value);
+
+    lookup = now () - start;
+
+    printf ("%-8s %12.1f %12.1f\n", "intmap", KEY_COUNT / insert / 1e6, KEY_COUNT / lookup / 1e6);
+
+    intmap_free (im);
+
+    free_keys (keys, KEY_COUNT);
+    free (ids);
+
+}
+
+
+/* hit rate and throughput of lru caches of several capacities
+ * on a zipfian trace, evicting least recently used bindings
+ * against giving them a second chance in clock mode */
+static void
+bench_lru (void)
+{
+
+    size_t i, j, m, hits;
+
+    double start, elapsed;
+
+    Lru c;
+    Any value;
+    Key *keys;
+    size_t *trace;
+
+    static const int flags[] = { 0, LRU_CLOCK };
+    static const size_t shares[] = { 1000, 100, 10 };
+
+    keys = make_keys (TRACE_KEYS, 16);
+    trace = make_zipf_trace (TRACE_KEYS, TRACE_LENGTH);
+
+    printf ("%-8s %10s %10s %12s\n", "policy", "capacity", "hit rate", "access Mops");
+
+    for (m = 0; m < sizeof (flags) / sizeof (*flags); ++m) {
+
+        for (j = 0; j < sizeof (shares) / sizeof (*shares); ++j) {
+
+            lru_init_with_policy (&c, TRACE_KEYS / shares[j], flags[m], NULL, NULL);
+
+            start = now ();
+
+            // fill cache on misses
+            for (i = 0, hits = 0; i < TRACE_LENGTH; ++i) {
+
+                if (lru_get (c, keys[trace[i]], &value) == MAP_OK)
+                    ++hits;
+                else
+                    lru_put (c, keys[trace[i]], keys[trace[i]]);
+
+            }
+
+            elapsed = now () - start;
+
+            printf ("%-8s %10zu %9.1f%% %12.1f\n", flags[m] ? "clock" : "lru", TRACE_KEYS / shares[j],
+                    100.0 * hits / TRACE_LENGTH, TRACE_LENGTH / elapsed / 1e6);
+
+            lru_free (c);
+        }
+    }
+
+    free (trace);
+    free_keys (keys, TRACE_KEYS);
+
+}
+
+
+/* membership tests in a hashmap used as set against a hashset,
+ * and set operations between two overlapping hashsets */
+static void
+bench_set (void)
+{
+
+    size_t i;
+
+    double start, map, set, ops[3];
+
+    Hashmap h;
+    Hashset a, b;
+    Key *keys;
+
+    keys = make_keys (KEY_COUNT, 16);
+
+    map_init (&h);
+    set_init (&a);
+
+    for (i = 0; i < KEY_COUNT; ++i) {
+        map_insert (h, keys[i], NULL);
+        set_insert (a, keys[i]);
+    }
+
+    start = now ();
+
+    for (i = 0; i < KEY_COUNT; ++i)
+        map_contains (h, keys[(i * 7919) % KEY_COUNT]);
+
+    map = now () - start;
+    start = now ();
+
+    for (i = 0; i < KEY_COUNT; ++i)
+        set_contains (a, keys[(i * 7919) % KEY_COUNT]);
+
+    set = now () - start;
+
+    printf ("%-8s %12s\n", "type", "contains Mops");
+    printf ("%-8s %12.1f\n", "hashmap", KEY_COUNT / map / 1e6);
+    printf ("%-8s %12.1f\n", "hashset", KEY_COUNT / set / 1e6);
+
+    map_free (h);
+    set_free (a);
+
+    // halves of keys overlapping by a quarter
+    set_init (&a);
+    set_init (&b);
+
+    for (i = 0; i < KEY_COUNT / 2; ++i) {
+        set_insert (a, keys[i]);
+        set_insert (b, keys[i + KEY_COUNT / 4]);
+    }
+
+    start = now ();
+    set_intersect (a, b);
+    ops[0] = now () - start;
+
+    start = now ();
+    set_union (a, b);
+    ops[1] = now () - start;
+
+    start = now ();
+    set_difference (a, b);
+    ops[2] = now () - start;
+
+    printf ("\n%-10s %12s\n", "operation", "ms");
+    printf ("%-10s %12.1f\n", "intersect", ops[0] * 1e3);
+    printf ("%-10s %12.1f\n", "union", ops[1] * 1e3);
+    printf ("%-10s %12.1f\n", "difference", ops[2] * 1e3);
+
+    set_free (a);
+    set_free (b);
+
+    free_keys (keys, KEY_COUNT);
+
+}
+
+
+/* successive lookups against batched lookups on a table exceeding the cache */
+static void
+bench_batch (void)
+{
+
+    size_t i, j;
+
+    double start, single, batch;
+
+    Hashmap h;
+    Any value;
+    Key *keys;
+
+    Key query[32];
+    Any values[32];
+    int results[32];
+
+    keys = make_keys (4 * KEY_COUNT, 16);
+
+    map_init_with_capacity (&h, 4 * KEY_COUNT);
+
+    for (i = 0; i < 4 * KEY_COUNT; ++i)
+        map_insert (h, keys[i], keys[i]);
+
+    printf ("%-8s %12s\n", "lookup", "Mops");
+
+    start = now ();
+
+    for (i = 0; i < 4 * KEY_COUNT; ++i)
+        map_lookup (h, keys[rnd () % (4 * KEY_COUNT)], &value);
+
+    single = now () - start;
+    start = now ();
+
+    for (i = 0; i < 4 * KEY_COUNT; i += 32) {
+
+        for (j = 0; j < 32; ++j)
+            query[j] = keys[rnd () % (4 * KEY_COUNT)];
+
+        map_lookup_batch (h, query, 32, values, results);
+
+    }
+
+    batch = now () - start;
+
+    printf ("%-8s %12.1f\n", "single", 4 * KEY_COUNT / single / 1e6);
+    printf ("%-8s %12.1f\n", "batch", 4 * KEY_COUNT / batch / 1e6);
+
+    map_free (h);
+
+    free_keys (keys, 4 * KEY_COUNT);
+
+}
+
+
+static const size_t thread_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+static const int read_percents[] = { 50, 90, 100 };
+
+
+typedef struct {
+    /* hashmap guarded by mutex, or NULL */
+    Hashmap map;
+    pthread_mutex_t *mutex;
+    /* sharded hashmap, or NULL */
+    Shardmap shards;
+    /* keys to draw from */
+    Key *keys;
+    /* operations to run */
+    size_t ops;
+    /* share of lookups in operations, rest are inserts */
+    int read_percent;
+    /* random state of thread */
+    uint64_t state;
+
+} worker;
+
+
+/* run mixed lookups and inserts against the map of worker */
+static void *
+run_worker (void *arg)
+{
+
+    size_t i;
+
+    Any value;
+    Key key;
+
+    worker *w = arg;
+
+    for (i = 0; i < w->ops; ++i) {
+
+        key = w->keys[xorshift (&w->state) % KEY_COUNT];
+
+        if (w->shards) {
+
+            if ((int) (xorshift (&w->state) % 100) < w->read_percent)
+                shardmap_lookup (w->shards, key, &value);
+            else
+                shardmap_insert (w->shards, key, key);
+
+        } else {
+
+            pthread_mutex_lock (w->mutex);
+
+            if ((int) (xorshift (&w->state) % 100) < w->read_percent)
+                map_lookup (w->map, key, &value);
+            else
+                map_insert (w->map, key, key);
+
+            pthread_mutex_unlock (w->mutex);
+
+        }
+    }
+
+    return NULL;
+
+}
+
+
+/* run given count of workers on copies of prototype, seconds taken */
+static double
+run_workers (const worker *proto, size_t count)
+{
+
+    size_t i;
+
+    double start;
+
+    pthread_t threads[64];
+    worker workers[64];
+
+    start = now ();
+
+    for (i = 0; i < count; ++i) {
+
+        workers[i] = *proto;
+        workers[i].ops = proto->ops / count;
+        workers[i].state = rnd () | 1;
+
+        pthread_create (&threads[i], NULL, run_worker, &workers[i]);
+
+    }
+
+    for (i = 0; i < count; ++i)
+        pthread_join (threads[i], NULL);
+
+    return now () - start;
+
+}
+
+
+/* throughput of a hashmap behind one mutex against a sharded hashmap by thread count */
+static void
+bench_threads (void)
+{
+
+    size_t i, t, r;
+
+    double mutexed, sharded;
+
+    pthread_mutex_t mutex;
+
+    Key *keys;
+    worker w, m;
+
+    keys = make_keys (KEY_COUNT, 16);
+
+    pthread_mutex_init (&mutex, NULL);
+
+    w.keys = keys;
+    w.mutex = &mutex;
+    w.ops = 4 * KEY_COUNT;
+
+    map_init_with_capacity (&w.map, KEY_COUNT);
+    shardmap_init (&w.shards, 0, 0);
+
+    for (i = 0; i < KEY_COUNT; ++i) {
+
+        map_insert (w.map, keys[i], keys[i]);
+        shardmap_insert (w.shards, keys[i], keys[i]);
+
+    }
+
+    printf ("%7s %6s %12s %12s\n", "threads", "read%", "mutex Mops", "shard Mops");
+
+    for (r = 0; r < sizeof (read_percents) / sizeof (*read_percents); ++r) {
+
+        for (t = 0; t < sizeof (thread_counts) / sizeof (*thread_counts); ++t) {
+
+            w.read_percent = read_percents[r];
+
+            m = w;
+            m.shards = NULL;
+
+            mutexed = run_workers (&m, thread_counts[t]);
+            sharded = run_workers (&w, thread_counts[t]);
+
+            printf ("%7zu %6d %12.1f %12.1f\n", thread_counts[t], read_percents[r],
+                    w.ops / mutexed / 1e6, w.ops / sharded / 1e6);
+        }
+    }
+
+    map_free (w.map);
+    shardmap_free (w.shards);
+    pthread_mutex_destroy (&mutex);
+
+    free_keys (keys, KEY_COUNT);
+
+}
+
+
+typedef struct {
+    /* hashmap to read */
+    Hashmap map;
+    /* lock guarding map, NULL for lock free lookups */
+    pthread_rwlock_t *lock;
+    /* keys to draw lookups from, or to update by writer */
+    Key *keys;
+    /* lookups to run */
+    size_t ops;
+    /* random state of thread */
+    uint64_t state;
+    /* set to stop writer */
+    volatile int stop;
+
+} reader;
+
+
+/* look up random keys in the map of reader */
+static void *
+run_reader (void *arg)
+{
+
+    size_t i;
+
+    Any value;
+
+    reader *r = arg;
+
+    for (i = 0; i < r->ops; ++i) {
+
+        if (r->lock)
+            pthread_rwlock_rdlock (r->lock);
+
+        map_lookup (r->map, r->keys[xorshift (&r->state) % KEY_COUNT], &value);
+
+        if (r->lock)
+            pthread_rwlock_unlock (r->lock);
+
+    }
+
+    return NULL;
+
+}
+
+
+/* update values of keys of reader until stopped, without resizes
+ * that would leave tables to reclaim behind */
+static void *
+run_writer (void *arg)
+{
+
+    size_t i;
+
+    reader *w = arg;
+
+    for (i = 0; !w->stop; i = (i + 1) % KEY_COUNT) {
+
+        if (w->lock)
+            pthread_rwlock_wrlock (w->lock);
+
+        map_insert (w->map, w->keys[i], w->keys[KEY_COUNT - 1 - i]);
+
+        if (w->lock)
+            pthread_rwlock_unlock (w->lock);
+
+    }
+
+    return NULL;
+
+}
+
+
+/* lookup throughput of readers beside one writer, behind a reader
+ * writer lock against lock free lookups */
+static void
+bench_readers (void)
+{
+
+    size_t i, t, m;
+
+    double start, elapsed[2];
+
+    pthread_rwlock_t lock;
+    pthread_t threads[64], writer;
+
+    Key *keys;
+    reader readers[64], w;
+
+    keys = make_keys (KEY_COUNT, 16);
+
+    pthread_rwlock_init (&lock, NULL);
+
+    printf ("%7s %12s %12s\n", "readers", "rwlock Mops", "seq Mops");
+
+    for (t = 0; t < sizeof (thread_counts) / sizeof (*thread_counts); ++t) {
+
+        for (m = 0; m < 2; ++m) {
+
+            w.lock = m ? NULL : &lock;
+            w.keys = keys;
+            w.stop = 0;
+
+            map_init_with_flags (&w.map, m ? MAP_CONCURRENT_READS : 0);
+
+            for (i = 0; i < KEY_COUNT; ++i)
+                map_insert (w.map, keys[i], keys[i]);
+
+            pthread_create (&writer, NULL, run_writer, &w);
+
+            start = now ();
+
+            for (i = 0; i < thread_counts[t]; ++i) {
+
+                readers[i] = w;
+                readers[i].ops = 4 * KEY_COUNT / thread_counts[t];
+                readers[i].state = rnd () | 1;
+
+                pthread_create (&threads[i], NULL, run_reader, &readers[i]);
+
+            }
+
+            for (i = 0; i < thread_counts[t]; ++i)
+                pthread_join (threads[i], NULL);
+
+            elapsed[m] = now () - start;
+
+            w.stop = 1;
+            pthread_join (writer, NULL);
+
+            map_free (w.map);
+        }
+
+        printf ("%7zu %12.1f %12.1f\n", thread_counts[t],
+                4 * KEY_COUNT / elapsed[0] / 1e6, 4 * KEY_COUNT / elapsed[1] / 1e6);
+    }
+
+    pthread_rwlock_destroy (&lock);
+
+    free_keys (keys, KEY_COUNT);
+
+}
+
+
+/* hashmap load throughput of single inserts and of bulk insertion by thread count */
+static void
+bench_bulk (void)
+{
+
+    size_t i, t;
+
+    double start, elapsed;
+
+    Hashmap h;
+    Key *keys;
+
+    keys = make_keys (KEY_COUNT, 16);
+
+    printf ("%-8s %8s %12s\n", "load", "threads", "insert Mops");
+
+    map_init (&h);
+
+    start = now ();
+
+    for (i = 0; i < KEY_COUNT; ++i)
+        map_insert (h, keys[i], keys[i]);
+
+    elapsed = now () - start;
+
+    printf ("%-8s %8d %12.1f\n", "single", 1, KEY_COUNT / elapsed / 1e6);
+
+    map_free (h);
+
+    for (t = 0; t < sizeof (thread_counts) / sizeof (*thread_counts); ++t) {
+
+        map_init (&h);
+
+        start = now ();
+
+        map_insert_bulk (h, keys, (const Any *) keys, KEY_COUNT, thread_counts[t]);
+
+        elapsed = now () - start;
+
+        printf ("%-8s %8zu %12.1f\n", "bulk", thread_counts[t], KEY_COUNT / elapsed / 1e6);
+
+        map_free (h);
+    }
+
+    free_keys (keys, KEY_COUNT);
+
+}
+
+
+/* add length of key to sum given as context */
+static void
+sum_len (const void *key, size_t len, Any value, void *ctx)
+{
+
+    (void) key;
+    (void) value;
+
+    __atomic_fetch_add ((size_t *) ctx, len, __ATOMIC_RELAXED);
+
+}
+
+
+/* scan of a hashmap by one iterator against parallel foreach by thread count */
+static void
+bench_foreach (void)
+{
+
+    size_t i, t, len, sum;
+
+    double start, elapsed;
+
+    Hashmap h;
+    Iterator it;
+    const void *key;
+    Any value;
+    Key *keys;
+
+    keys = make_keys (KEY_COUNT, 16);
+
+    map_init (&h);
+
+    for (i = 0; i < KEY_COUNT; ++i)
+        map_insert (h, keys[i], keys[i]);
+
+    printf ("%-8s %8s %12s\n", "scan", "threads", "Mbindings/s");
+
+    start = now ();
+
+    map_iter_init (&it, h);
+
+    for (sum = 0; map_iter_next_n (it, &key, &len, &value) == MAP_OK; sum += len);
+
+    map_iter_free (it);
+
+    elapsed = now () - start;
+
+    printf ("%-8s %8d %12.1f\n", "iterator", 1, KEY_COUNT / elapsed / 1e6);
+
+    for (t = 0; t < sizeof (thread_counts) / sizeof (*thread_counts); ++t) {
+
+        sum = 0;
+
+        start = now ();
+
+        map_parallel_foreach (h, sum_len, &sum, thread_counts[t]);
+
+        elapsed = now () - start;
+
+        printf ("%-8s %8zu %12.1f\n", "foreach", thread_counts[t], KEY_COUNT / elapsed / 1e6);
+    }
+
+    map_free (h);
+
+    free_keys (keys, KEY_COUNT);
+
+}
+
+
+/* rebuilding a hashmap by inserts against opening a saved image */
+static void
+bench_image (void)
+{
+
+    size_t i;
+
+    double start, build, open;
+
+    const char *path = "bench.img";
+
+    Hashmap h;
+    Any value;
+    Key *keys;
+
+    keys = make_keys (4 * KEY_COUNT, 16);
+
+    start = now ();
+
+    map_init (&h);
+
+    for (i = 0; i < 4 * KEY_COUNT; ++i)
+        map_insert (h, keys[i], keys[i]);
+
+    build = now () - start;
+
+    map_save (h, path);
+    map_free (h);
+
+    start = now ();
+
+    map_open_mmap (&h, path);
+    map_lookup (h, keys[0], &value);
+
+    open = now () - start;
+
+    printf ("%-8s %12s\n", "startup", "ms");
+    printf ("%-8s %12.3f\n", "insert", build * 1e3);
+    printf ("%-8s %12.3f\n", "mmap", open * 1e3);
+
+    map_free (h);
+    remove (path);
+
+    free_keys (keys, 4 * KEY_COUNT);
+
+}
+
+
+/* lookups in a hashmap against lookups in the frozen hashmap built from it */
+static void
+bench_frozen (void)
+{
+
+    size_t i;
+
+    double start, freeze, lookup, frozen;
+
+    Hashmap h;
+    Frozenmap f;
+    Any value;
+    Key *keys;
+
+    keys = make_keys (KEY_COUNT, 16);
+
+    map_init (&h);
+
+    for (i = 0; i < KEY_COUNT; ++i)
+        map_insert (h, keys[i], keys[i]);
+
+    start = now ();
+
+    map_freeze (h, &f);
+
+    freeze = now () - start;
+    start = now ();
+
+    for (i = 0; i < KEY_COUNT; ++i)
+        map_lookup (h, keys[(i * 7919) % KEY_COUNT], &value);
+
+    lookup = now () - start;
+    start = now ();
+
+    for (i = 0; i < KEY_COUNT; ++i)
+        frozen_lookup (f, keys[(i * 7919) % KEY_COUNT], &value);
+
+    frozen = now () - start;
+
+    printf ("%-8s %12s %12s\n", "map", "build ms", "lookup Mops");
+    printf ("%-8s %12s %12.1f\n", "hashmap", "-", KEY_COUNT / lookup / 1e6);
+    printf ("%-8s %12.1f %12.1f\n", "frozen", freeze * 1e3, KEY_COUNT / frozen / 1e6);
+
+    map_free (h);
+    frozen_free (f);
+
+    free_keys (keys, KEY_COUNT);
+
+}
+
+
+typedef struct {
+    /* name to select benchmark on command line */
+    const char *name;
+    /* benchmark */
+    void (*run) (void);
+
+} benchmark;
+
+
+static const benchmark benchmarks[] = {
+    { "hash",    bench_hash    },
+    { "map",     bench_map     },
+    { "sizing",  bench_sizing  },
+    { "probing", bench_probing },
+    { "flood",   bench_flood   },
+    { "compact", bench_compact },
+    { "churn",   bench_churn   },
+    { "upsert",  bench_upsert  },
+    { "tiny",    bench_tiny    },
+    { "latency", bench_latency },
+    { "intmap",  bench_intmap  },
+    { "batch",   bench_batch   },
+    { "set",     bench_set     },
+    { "lru",     bench_lru     },
+    { "threads", bench_threads },
+    { "readers", bench_readers },
+    { "bulk",    bench_bulk    },
+    { "foreach", bench_foreach },
+    { "image",   bench_image   },
+    { "frozen",  bench_frozen  },
+};
+
+
+/* run benchmarks given on command line, all if none given */
+int
+main (int argc, char **argv)
+{
+
+    int i;
+    size_t b;
+
+    for (b = 0; b < sizeof (benchmarks) / sizeof (*benchmarks); ++b) {
+
+        for (i = 1; i < argc && strcmp (argv[i], benchmarks[b].name) != 0; ++i);
+
+        if (argc > 1 && i == argc)
+            continue;
+
+        printf ("== %s\n", benchmarks[b].name);
+        benchmarks[b].run ();
+        printf ("\n");
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,625 @@
+/**
+ * frozen.c
+ *
+ * implementation of a read only hashmap built from a hashmap by
+ * compress, hash and displace into a minimal perfect hash, so that
+ * every lookup touches exactly one binding.
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frozen.h"
+
+
+/* average count of keys per bucket */
+#define BUCKET_SIZE                     4
+
+/* first displacements tried per bucket before giving up on a seed */
+#define MAX_DISPLACEMENT                256
+
+/* seeds tried before giving up on building */
+#define MAX_SEEDS                       16
+
+/* golden ratio multiplier deriving second position hash */
+#define FIBONACCI                       0x9e3779b97f4a7c15ull
+
+
+typedef struct {
+    /* key in key storage of frozen hashmap */
+    Key key;
+    /* any value */
+    Any value;
+    /* length of key */
+    size_t len;
+
+} binding;
+
+
+/* displacement of the keys of a bucket, a key with position
+ * hashes f1 and f2 is stored at (f1 + d0 * f2 + d1) % count */
+typedef struct {
+    uint32_t d0;
+    uint32_t d1;
+
+} displacement;
+
+
+typedef struct {
+    /* binding count, equal to slot count */
+    size_t count;
+    /* bucket count */
+    size_t buckets;
+    /* seed of hash */
+    uint64_t seed;
+    /* displacements, one per bucket */
+    displacement *displacements;
+    /* bindings, one per slot */
+    binding *bindings;
+    /* keys, each terminated by NUL */
+    char *keys;
+
+} frozenmap;
+
+
+typedef struct {
+    /* index of next binding */
+    size_t next;
+    /* map to iterate */
+    frozenmap *map;
+
+} frozenmap_iterator;
+
+
+/* bucket of hash */
+static inline size_t
+bucket_of (const frozenmap *map, uint64_t h)
+{
+
+    return (size_t) (((h >> 32) * map->buckets) >> 32);
+
+}
+
+/* slot of hash within its bucket under given displacement */
+static inline size_t
+slot_of (const frozenmap *map, uint64_t h, const displacement *d)
+{
+
+    uint64_t f1 = (uint32_t) h % map->count;
+    uint64_t f2 = ((h * FIBONACCI) >> 32) % map->count;
+
+    return (size_t) ((f1 + d->d0 * f2 + d->d1) % map->count);
+
+}
+
+
+/* find displacements placing every key in a slot of its own,
+ * buckets are placed from largest to smallest */
+static int
+displace (frozenmap *map, const uint64_t *hashes, size_t *slots)
+{
+
+    int ret = MAP_OUT_OF_MEMORY;
+
+    size_t i, j, b, p, end, max, free_slot;
+
+    displacement d;
+
+    // keys sorted by bucket, start of each bucket within, buckets sorted by size
+    size_t *keys = malloc (map->count * sizeof (size_t));
+    size_t *start = calloc (map->buckets + 1, sizeof (size_t));
+    size_t *order = malloc (map->buckets * sizeof (size_t));
+    size_t *sizes = calloc (map->count + 2, sizeof (size_t));
+    uint8_t *taken = calloc (map->count, 1);
+
+    if (!keys || !start || !order || !sizes || !taken)
+        goto DONE;
+
+    // counting sort of keys by bucket
+    for (i = 0; i < map->count; ++i)
+        ++start[bucket_of (map, hashes[i]) + 1];
+
+    for (b = 0; b < map->buckets; ++b)
+        start[b + 1] += start[b];
+
+    for (i = 0; i < map->count; ++i)
+        keys[start[bucket_of (map, hashes[i])]++] = i;
+
+    for (b = map->buckets; b > 0; --b)
+        start[b] = start[b - 1];
+
+    start[0] = 0;
+
+    // counting sort of buckets by descending size
+    for (b = 0; b < map->buckets; ++b)
+        ++sizes[map->count - (start[b + 1] - start[b]) + 1];
+
+    for (i = 0; i <= map->count; ++i)
+        sizes[i + 1] += sizes[i];
+
+    for (b = 0; b < map->buckets; ++b)
+        order[sizes[map->count - (start[b + 1] - start[b])]++] = b;
+
+    ret = MAP_PROBING_FAILED;
+
+    for (max = 0, free_slot = 0; max < map->buckets; ++max) {
+
+        b = order[max];
+        end = start[b + 1];
+
+        // remaining buckets are empty
+        if (start[b] == end)
+            break;
+
+        // single key takes next free slot
+        if (end - start[b] == 1) {
+
+            for (; taken[free_slot]; ++free_slot);
+
+            d.d0 = 0;
+            d.d1 = 0;
+
+            p = slot_of (map, hashes[keys[start[b]]], &d);
+
+            d.d1 = (free_slot + map->count - p) % map->count;
+
+            slots[keys[start[b]]] = free_slot;
+            taken[free_slot] = 1;
+
+            goto PLACED;
+        }
+
+        for (d.d0 = 0; d.d0 < MAX_DISPLACEMENT; ++d.d0) {
+
+            d.d1 = 0;
+
+            // slots of keys without second displacement, must differ
+            for (i = start[b]; i < end; ++i) {
+
+                slots[keys[i]] = slot_of (map, hashes[keys[i]], &d);
+
+                for (j = start[b]; j < i && slots[keys[j]] != slots[keys[i]]; ++j);
+
+                if (j < i)
+                    break;
+
+            }
+
+            if (i < end)
+                continue;
+
+            // move first key over free slots, test the others along
+            for (p = slots[keys[start[b]]]; d.d1 < map->count; ++d.d1, p = p + 1 < map->count ? p + 1 : 0) {
+
+                if (taken[p])
+                    continue;
+
+                for (i = start[b] + 1; i < end && !taken[(slots[keys[i]] + d.d1) % map->count]; ++i);
+
+                if (i < end)
+                    continue;
+
+                // claim slots
+                for (i = start[b]; i < end; ++i) {
+                    slots[keys[i]] = (slots[keys[i]] + d.d1) % map->count;
+                    taken[slots[keys[i]]] = 1;
+                }
+
+                goto PLACED;
+            }
+        }
+
+        // keys collide under every displacement
+        goto DONE;
+
+PLACED:
+        map->displacements[b] = d;
+
+    }
+
+    ret = MAP_OK;
+
+DONE:
+    free (keys);
+    free (start);
+    free (order);
+    free (sizes);
+    free (taken);
+
+    return ret;
+
+}
+
+
+/* delete frozen hashmap */
+int
+frozen_free (Frozenmap fm)
+{
+
+    frozenmap *map = fm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    free (map->displacements);
+    free (map->bindings);
+    free (map->keys);
+    free (map);
+
+    return MAP_OK;
+
+}
+
+
+/* build read only frozen hashmap holding copies of the bindings of hashmap */
+int
+map_freeze (const Hashmap hm, Frozenmap *fm)
+{
+
+    int ret;
+
+    size_t i, size;
+
+    const void *key;
+    size_t len;
+
+    uint64_t *hashes = NULL;
+    size_t *slots = NULL;
+    binding *bindings = NULL;
+
+    Any value;
+    Iterator it;
+
+    char *copy;
+    frozenmap *map;
+
+    if (!hm)
+        return MAP_INVALID;
+
+    map = calloc (1, sizeof (frozenmap));
+
+    if (!map)
+        return MAP_OUT_OF_MEMORY;
+
+    map_count (hm, &map->count);
+
+    // displacements are 32 bit
+    if (map->count > UINT32_MAX) {
+        free (map);
+
+        return MAP_INVALID_ARGUMENT;
+    }
+
+    ret = map_iter_init (&it, hm);
+
+    if (ret != MAP_OK) {
+        free (map);
+
+        return ret;
+    }
+
+    // size of key storage
+    for (size = 0; map_iter_next_n (it, &key, &len, &value) == MAP_OK; size += len + 1);
+
+    map->buckets = map->count / BUCKET_SIZE + 1;
+    map->keys = malloc (size ? size : 1);
+    map->bindings = malloc ((map->count ? map->count : 1) * sizeof (binding));
+    map->displacements = calloc (map->buckets, sizeof (displacement));
+
+    bindings = malloc ((map->count ? map->count : 1) * sizeof (binding));
+    hashes = malloc ((map->count ? map->count : 1) * sizeof (uint64_t));
+    slots = malloc ((map->count ? map->count : 1) * sizeof (size_t));
+
+    ret = MAP_OUT_OF_MEMORY;
+
+    if (!map->keys || !map->bindings || !map->displacements || !bindings || !hashes || !slots)
+        goto DONE;
+
+    // copy keys and values
+    map_iter_reset (it, hm);
+
+    for (i = 0, copy = map->keys; map_iter_next_n (it, &key, &len, &value) == MAP_OK; ++i) {
+
+        bindings[i].key = memcpy (copy, key, len);
+        bindings[i].key[len] = '\0';
+        bindings[i].len = len;
+        bindings[i].value = value;
+
+        copy += len + 1;
+
+    }
+
+    ret = map->count ? MAP_PROBING_FAILED : MAP_OK;
+
+    // keys colliding under every displacement need other hashes
+    for (map->seed = 0; ret == MAP_PROBING_FAILED && map->seed < MAX_SEEDS; ) {
+
+        for (i = 0; i < map->count; ++i)
+            hashes[i] = map_hash_wyhash (bindings[i].key, bindings[i].len, map->seed);
+
+        ret = displace (map, hashes, slots);
+
+        if (ret == MAP_PROBING_FAILED)
+            ++map->seed;
+
+    }
+
+    if (ret != MAP_OK)
+        goto DONE;
+
+    // move bindings to their slots
+    for (i = 0; i < map->count; ++i)
+        map->bindings[slots[i]] = bindings[i];
+
+DONE:
+    map_iter_free (it);
+
+    free (bindings);
+    free (hashes);
+    free (slots);
+
+    if (ret != MAP_OK) {
+        frozen_free (map);
+
+        return ret;
+    }
+
+    *fm = map;
+
+    return MAP_OK;
+
+}
+
+
+/* retreive value of given key from frozen hashmap */
+int
+frozen_lookup (const Frozenmap fm, const Key key, Any *value)
+{
+
+    return frozen_lookup_n (fm, key, strlen (key), value);
+
+}
+
+
+/* retreive value of given key of given length from frozen hashmap,
+ * comparing with the one binding its slot may hold */
+int
+frozen_lookup_n (const Frozenmap fm, const void *key, size_t len, Any *value)
+{
+
+    uint64_t h;
+
+    binding *b;
+
+    frozenmap *map = fm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    *value = NULL;
+
+    if (!map->count)
+        return MAP_KEY_NOT_FOUND;
+
+    h = map_hash_wyhash (key, len, map->seed);
+    b = &map->bindings[slot_of (map, h, &map->displacements[bucket_of (map, h)])];
+
+    if (b->len != len || memcmp (b->key, key, len) != 0)
+        return MAP_KEY_NOT_FOUND;
+
+    // retreive value
+    *value = b->value;
+
+    return MAP_OK;
+
+}
+
+
+/* test if frozen hashmap contains binding with given key */
+int
+frozen_contains (const Frozenmap fm, const Key key)
+{
+
+    return frozen_contains_n (fm, key, strlen (key));
+
+}
+
+
+/* test if frozen hashmap contains binding with given key of given length */
+int
+frozen_contains_n (const Frozenmap fm, const void *key, size_t len)
+{
+
+    Any value;
+
+    return frozen_lookup_n (fm, key, len, &value);
+
+}
+
+
+/* retreive count of bindings from frozen hashmap */
+int
+frozen_count (const Frozenmap fm, size_t *count)
+{
+
+    frozenmap *map = fm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    *count = map->count;
+
+    return MAP_OK;
+
+}
+
+
+/* initialize frozen hashmap iterator */
+int
+frozen_iter_init (Iterator *it, const Frozenmap fm)
+{
+
+    frozenmap_iterator *iter;
+
+    frozenmap *map = fm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    iter = malloc (sizeof (frozenmap_iterator));
+
+    if (!iter)
+        return MAP_OUT_OF_MEMORY;
+
+    // set map to iterate
+    iter->map = map;
+
+    // point iterator to first binding
+    iter->next = 0;
+
+    *it = iter;
+
+    return MAP_OK;
+
+}
+
+/* delete frozen hashmap iterator */
+int
+frozen_iter_free (Iterator it)
+{
+
+    frozenmap_iterator *iter = it;
+
+    if (!iter)
+        return MAP_INVALID;
+
+    free (iter);
+
+    return MAP_OK;
+
+}
+
+
+/* test for next binding in frozen hashmap iterator */
+int
+frozen_iter_has_next (const Iterator it)
+{
+
+    frozenmap_iterator *iter = it;
+
+    if (!iter)
+        return MAP_INVALID;
+
+    if (iter->next >= iter->map->count)
+        return MAP_ITERATOR_EXHAUSTED;
+
+    return MAP_OK;
+
+}
+
+
+/* retreive next binding from frozen hashmap iterator */
+int
+frozen_iter_next (Iterator it, Key *key, Any *value)
+{
+
+    int ret;
+
+    const void *k;
+
+    ret = frozen_iter_next_n (it, &k, NULL, value);
+
+    if (ret != MAP_INVALID)
+        *key = (Key) k;
+
+    return ret;
+
+}
+
+
+/* retreive next binding and its key length from frozen hashmap iterator */
+int
+frozen_iter_next_n (Iterator it, const void **key, size_t *len, Any *value)
+{
+
+    binding *b;
+
+    frozenmap_iterator *iter = it;
+
+    if (!iter)
+        return MAP_INVALID;
+
+    if (iter->next >= iter->map->count) {
+        // no next binding
+        *key = NULL;
+        *value = NULL;
+
+        if (len)
+            *len = 0;
+
+        return MAP_ITERATOR_EXHAUSTED;
+    }
+
+    // retreive binding, slots hold one binding each
+    b = &iter->map->bindings[iter->next++];
+
+    *key = b->key;
+    *value = b->value;
+
+    if (len)
+        *len = b->len;
+
+    return MAP_OK;
+
+}
+
+
+/* reset frozen hashmap iterator */
+int
+frozen_iter_reset (Iterator it, const Frozenmap fm)
+{
+
+    frozenmap *map = fm;
+    frozenmap_iterator *iter = it;
+
+    if (!map || !iter)
+        return MAP_INVALID;
+
+    // reset map to iterate
+    iter->map = map;
+
+    // point iterator to first binding
+    iter->next = 0;
+
+    return MAP_OK;
+
+}
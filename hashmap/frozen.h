@@ -0,0 +1,86 @@
+/**
+ * frozen.h
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#ifndef FROZEN_H
+#define FROZEN_H
+
+
+#include <stddef.h>
+
+#include "hashmap.h"
+
+
+/* pointer to the internally managed frozen hashmap datastructure */
+typedef void *Frozenmap;
+
+
+/* build read only frozen hashmap holding copies of the bindings of hashmap */
+extern int map_freeze (const Hashmap hm, Frozenmap *fm);
+
+/* delete frozen hashmap */
+extern int frozen_free (Frozenmap fm);
+
+/* retreive value from frozen hashmap */
+extern int frozen_lookup (const Frozenmap fm, const Key key, Any *value);
+
+/* test if frozen hashmap contains binding with given key */
+extern int frozen_contains (const Frozenmap fm, const Key key);
+
+/* retreive value from frozen hashmap by binary key of given length */
+extern int frozen_lookup_n (const Frozenmap fm, const void *key, size_t len, Any *value);
+
+/* test if frozen hashmap contains binding with binary key of given length */
+extern int frozen_contains_n (const Frozenmap fm, const void *key, size_t len);
+
+/* retreive count of bindings from frozen hashmap */
+extern int frozen_count (const Frozenmap fm, size_t *count);
+
+/* initialize frozen hashmap iterator */
+extern int frozen_iter_init (Iterator *it, const Frozenmap fm);
+
+/* delete frozen hashmap iterator */
+extern int frozen_iter_free (Iterator it);
+
+/* test for next binding in frozen hashmap iterator */
+extern int frozen_iter_has_next (const Iterator it);
+
+/* retreive next binding from frozen hashmap iterator */
+extern int frozen_iter_next (Iterator it, Key *key, Any *value);
+
+/* retreive next binding and its key length from frozen hashmap iterator, len may be NULL */
+extern int frozen_iter_next_n (Iterator it, const void **key, size_t *len, Any *value);
+
+/* reset frozen hashmap iterator */
+extern int frozen_iter_reset (Iterator it, const Frozenmap fm);
+
+
+#endif
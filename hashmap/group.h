@@ -0,0 +1,416 @@
+/**
+ * group.h
+ *
+ * control tags of open addressing tables, probed a group at a time.
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#ifndef GROUP_H
+#define GROUP_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+/* number of control tags scanned per probe */
+#define GROUP_WIDTH                     16
+
+
+/* control tag of a slot without binding */
+#define CTRL_EMPTY                      ((int8_t) -128)
+
+/* control tag of a slot whose binding was removed */
+#define CTRL_DELETED                    ((int8_t) -2)
+
+/* control tag of a slot with binding, 7 low bits of hash */
+#define CTRL_TAG(H)                     ((int8_t) ((H) & 0x7f))
+
+/* bytes of control tags of a table of given size, one per slot followed
+ * by clones of the first GROUP_WIDTH - 1 tags so that groups can be
+ * loaded across the end of the table */
+#define CTRL_SIZE(SIZE)                 ((SIZE) + GROUP_WIDTH - 1)
+
+/* slot at given offset from index with wrap around */
+#define WRAP(I, SIZE)                   ((I) >= (SIZE) ? (I) - (SIZE) : (I))
+
+
+/* index of lowest set bit in non-zero mask */
+static inline unsigned int
+lowest_bit (unsigned int mask)
+{
+
+#if defined(__GNUC__)
+    return __builtin_ctz (mask);
+#else
+    unsigned int i;
+
+    for (i = 0; !(mask & 1); ++i)
+        mask >>= 1;
+
+    return i;
+#endif
+
+}
+
+
+/* index of highest set bit in non-zero mask */
+static inline unsigned int
+highest_bit (unsigned int mask)
+{
+
+#if defined(__GNUC__)
+    return 31 - __builtin_clz (mask);
+#else
+    unsigned int i;
+
+    for (i = 0; mask >>= 1; ++i);
+
+    return i;
+#endif
+
+}
+
+
+#if defined(__SSE2__)
+
+/* mask of slots in group whose control tag equals given tag */
+static inline unsigned int
+group_match (const int8_t *ctrl, int8_t tag)
+{
+
+    __m128i group = _mm_loadu_si128 ((const __m128i *) ctrl);
+
+    return _mm_movemask_epi8 (_mm_cmpeq_epi8 (group, _mm_set1_epi8 (tag)));
+
+}
+
+/* mask of slots in group without binding or with removed binding */
+static inline unsigned int
+group_match_free (const int8_t *ctrl)
+{
+
+    __m128i group = _mm_loadu_si128 ((const __m128i *) ctrl);
+
+    // empty and deleted are the only tags with sign bit set
+    return _mm_movemask_epi8 (group);
+
+}
+
+#else
+
+/* mask of slots in group whose control tag equals given tag */
+static inline unsigned int
+group_match (const int8_t *ctrl, int8_t tag)
+{
+
+    unsigned int i, mask = 0;
+
+    for (i = 0; i < GROUP_WIDTH; ++i)
+        mask |= (unsigned int) (ctrl[i] == tag) << i;
+
+    return mask;
+
+}
+
+/* mask of slots in group without binding or with removed binding */
+static inline unsigned int
+group_match_free (const int8_t *ctrl)
+{
+
+    unsigned int i, mask = 0;
+
+    for (i = 0; i < GROUP_WIDTH; ++i)
+        mask |= (unsigned int) (ctrl[i] < 0) << i;
+
+    return mask;
+
+}
+
+#endif
+
+
+/* mask of slots in group without binding */
+static inline unsigned int
+group_match_empty (const int8_t *ctrl)
+{
+
+    return group_match (ctrl, CTRL_EMPTY);
+
+}
+
+
+/* control tag for slot at index of a table of given size after
+ * removing its binding, empty if no probe sequence can have passed
+ * a full group containing the slot, deleted otherwise */
+static inline int8_t
+removed_tag (const int8_t *ctrl, size_t size, size_t idx)
+{
+
+    unsigned int before, after;
+
+    // count occupied slots directly before and from removed slot
+    before = group_match_empty (ctrl + WRAP (idx + size - GROUP_WIDTH, size));
+    after = group_match_empty (ctrl + idx);
+
+    before = before ? GROUP_WIDTH - 1 - highest_bit (before) : GROUP_WIDTH;
+    after = after ? lowest_bit (after) : GROUP_WIDTH;
+
+    return before + after < GROUP_WIDTH ? CTRL_EMPTY : CTRL_DELETED;
+
+}
+
+
+/* set control tag of slot in table of given size and of its clone */
+static inline void
+ctrl_set (int8_t *ctrl, size_t size, size_t idx, int8_t tag)
+{
+
+    ctrl[idx] = tag;
+
+    if (idx < GROUP_WIDTH - 1)
+        ctrl[size + idx] = tag;
+
+}
+
+
+/* linear probe over groups for slots whose control tag matches */
+typedef struct {
+    /* first slot of group being probed */
+    size_t idx;
+    /* slots of group left to test */
+    unsigned int mask;
+    /* control tag being probed for */
+    int8_t tag;
+
+} ctrl_probe;
+
+
+/* start probe for given tag at home slot */
+static inline void
+ctrl_probe_init (ctrl_probe *p, const int8_t *ctrl, size_t idx, int8_t tag)
+{
+
+    p->idx = idx;
+    p->tag = tag;
+    p->mask = group_match (ctrl + idx, tag);
+
+}
+
+
+/* next slot whose tag matches in table of given size, false once a
+ * group with an empty slot is exhausted, as the probe of a key cannot
+ * have passed it, the load factor keeps at least one slot empty */
+static inline int
+ctrl_probe_next (ctrl_probe *p, const int8_t *ctrl, size_t size, size_t *slot)
+{
+
+    while (!p->mask) {
+
+        if (group_match_empty (ctrl + p->idx))
+            return 0;
+
+        p->idx = WRAP (p->idx + GROUP_WIDTH, size);
+        p->mask = group_match (ctrl + p->idx, p->tag);
+
+    }
+
+    *slot = WRAP (p->idx + lowest_bit (p->mask), size);
+    p->mask &= p->mask - 1;
+
+    return 1;
+
+}
+
+
+/* first slot with binding from given index on in table
+ * of given size, scanning a group at a time, size if none */
+static inline size_t
+ctrl_next_full (const int8_t *ctrl, size_t size, size_t idx)
+{
+
+    unsigned int mask;
+
+    for (; idx < size; idx += GROUP_WIDTH) {
+
+        // slots with binding are those whose tag lacks the sign bit
+        mask = ~group_match_free (ctrl + idx) & ((1u << GROUP_WIDTH) - 1);
+
+        // clones past the end of the table are not slots of their own
+        if (mask)
+            return idx + lowest_bit (mask) < size ? idx + lowest_bit (mask) : size;
+
+    }
+
+    return size;
+
+}
+
+
+/* first free slot probing groups linearly from given
+ * index, the load factor keeps at least one slot free */
+static inline size_t
+ctrl_find_free (const int8_t *ctrl, size_t size, size_t idx)
+{
+
+    unsigned int mask;
+
+    while (!(mask = group_match_free (ctrl + idx)))
+        idx = WRAP (idx + GROUP_WIDTH, size);
+
+    return WRAP (idx + lowest_bit (mask), size);
+
+}
+
+
+/* tag free slot at index, true if it reuses a deleted slot
+ * that the caller has to take off its count of deleted slots */
+static inline int
+ctrl_claim (int8_t *ctrl, size_t size, size_t idx, int8_t tag)
+{
+
+    int reused = ctrl[idx] == CTRL_DELETED;
+
+    ctrl_set (ctrl, size, idx, tag);
+
+    return reused;
+
+}
+
+
+/* untag slot at index after removing its binding, true if it is
+ * marked deleted and the caller has to count it as such */
+static inline int
+ctrl_release (int8_t *ctrl, size_t size, size_t idx)
+{
+
+    int8_t tag = removed_tag (ctrl, size, idx);
+
+    ctrl_set (ctrl, size, idx, tag);
+
+    return tag == CTRL_DELETED;
+
+}
+
+
+/* mark all slots of table of given size empty */
+static inline void
+ctrl_clear (int8_t *ctrl, size_t size)
+{
+
+    memset (ctrl, CTRL_EMPTY, CTRL_SIZE (size));
+
+}
+
+
+/* allocate control tags of table of given size, all empty */
+static inline int8_t *
+ctrl_alloc (size_t size)
+{
+
+    int8_t *ctrl = malloc (CTRL_SIZE (size));
+
+    if (ctrl)
+        ctrl_clear (ctrl, size);
+
+    return ctrl;
+
+}
+
+
+/* shift taking log2 of power of two table size from the top bits of 64 */
+static inline int
+table_shift (size_t size)
+{
+
+    int shift;
+
+    for (shift = 64; size >> (64 - shift) > 1; --shift);
+
+    return shift;
+
+}
+
+
+/* power of two table size of at least given number of slots,
+ * no less than a group so that groups never wrap onto themselves */
+static inline size_t
+table_size (size_t n)
+{
+
+    size_t size;
+
+    for (size = GROUP_WIDTH; size < n; size <<= 1);
+
+    return size;
+
+}
+
+
+/* power of two table size holding given count of bindings below load factor */
+static inline size_t
+table_fitting_size (size_t count, double load_factor)
+{
+
+    return table_size (count / load_factor + 1);
+
+}
+
+
+/* test if table of given size with given counts of bindings and deleted
+ * slots has reached the load factor and must be rehashed before
+ * another slot is claimed */
+static inline int
+table_full (size_t size, size_t load, size_t deleted, double load_factor)
+{
+
+    return load + deleted >= load_factor * size;
+
+}
+
+
+/* test if full table of given size is to be grown by growth rate when
+ * rehashed, rather than keep its size to purge mostly deleted slots */
+static inline int
+table_grows (size_t size, size_t load, double load_factor, double growth_rate)
+{
+
+    return load >= load_factor / growth_rate * size;
+
+}
+
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * hashed.h
+ *
+ * entry points of the hashmap taking the hash of the key, for the other
+ * modules of the library that hash keys for purposes of their own.
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#ifndef HASHED_H
+#define HASHED_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hashmap.h"
+
+
+/* hash of binary key of given length under hash function and seed of hashmap */
+extern uint64_t map_hash_key (const Hashmap hm, const void *key, size_t len);
+
+/* retreive value of binary key of given length and hash */
+extern int map_lookup_hashed (const Hashmap hm, const void *key, size_t len, uint64_t h, Any *value);
+
+/* update binary key of given length and hash or create new binding if not exists */
+extern int map_insert_hashed (Hashmap hm, const void *key, size_t len, uint64_t h, const Any value);
+
+/* remove binding with binary key of given length and hash from hashmap, retreiving its value unless null */
+extern int map_remove_hashed (Hashmap hm, const void *key, size_t len, uint64_t h, Any *value);
+
+/* test if hashmap contains binding with binary key of given length and hash */
+extern int map_contains_hashed (const Hashmap hm, const void *key, size_t len, uint64_t h);
+
+
+#endif
@@ -1,7 +1,8 @@
 /**
  * hashmap.c
  *
- * implementation of an open addressing hashmap with linear probing.
+ * implementation of an open addressing hashmap with linear probing
+ * over groups of control tags.
  *
  * Copyright (c) 2019, Tobias Heilig
  * All rights reserved.
@@ -32,28 +33,98 @@
  **/
 
 
+#define _POSIX_C_SOURCE 200112L
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "group.h"
+#include "hashed.h"
 #include "hashmap.h"
 
 
-/* initial table size */
-#define INITIAL_SIZE                    257
+/* initial table size, rounded up to next prime
+ * or power of two depending on mode */
+#define INITIAL_SIZE                    256
 
 /* exceeding this ratio between bindings and
- * table size will trigger a resize operation */
-#define LOAD_FACTOR_THRESHOLD           0.5
+ * table size will trigger a resize operation
+ * unless set otherwise for a hashmap */
+#define DEFAULT_LOAD_FACTOR             0.875
+
+/* factor by which the table size will grow on
+ * resize operations unless set otherwise for a hashmap */
+#define DEFAULT_GROWTH_RATE             2
+
+/* hash function used unless given on initialization */
+#define DEFAULT_HASH                    map_hash_wyhash
+
+/* bindings held inline in small mode before a table is allocated */
+#define SMALL_SIZE                      8
+
+/* slots moved to the new table per operation
+ * during incremental resize */
+#define MIGRATION_STEP                  64
+
+/* size of first chunk of key arena, doubling
+ * for each further chunk up to the maximum */
+#define ARENA_CHUNK_SIZE                4096
+
+/* words of removed keys that have to pile up in the key arena,
+ * beyond those of live keys, before it is compacted on removal */
+#define ARENA_PURGE_MIN                 (ARENA_CHUNK_SIZE / sizeof (size_t))
+
+/* maximum size of key arena chunks */
+#define ARENA_CHUNK_MAX_SIZE            (1 << 20)
+
+
+/* keys hashed and prefetched ahead of probing in batched lookups */
+#define LOOKUP_BATCH_SIZE               16
+
+/* least slots per worker in bulk insertion */
+#define BULK_MIN_REGION                 4096
+
+
+/* hint to fetch cache line of address ahead of access */
+#if defined(__GNUC__)
+#define PREFETCH(P)                     __builtin_prefetch (P)
+#else
+#define PREFETCH(P)                     ((void) (P))
+#endif
+
+
+/* magic and layout version at the start of hashmap images */
+#define IMAGE_MAGIC                     "HMAPIMG2"
+
+/* alignment of sections within hashmap images */
+#define IMAGE_ALIGN                     64
 
-/* factor by which the table size will
- * grow on resize operations */
-#define GROWTH_RATE                     2
+/* offset rounded up to alignment of image sections */
+#define IMAGE_ALIGN_UP(N)               (((N) + IMAGE_ALIGN - 1) / IMAGE_ALIGN * IMAGE_ALIGN)
 
-/* interval between probes */
-#define LINEAR_PROBING_INTERVAL         1
 
-/* maximum probing tries */
-#define LINEAR_PROBING_MAX_SEQUENCE     16
+/* count events for map_stats only when enabled */
+#if defined(MAP_STATS)
+#define STAT(X)                         X
+#else
+#define STAT(X)                         ((void) 0)
+#endif
+
+
+/* length marking an entry removed from the dense array in compact mode */
+#define ENTRY_REMOVED                   SIZE_MAX
+
+
+/* golden ratio multiplier for fibonacci hashing */
+#define FIBONACCI                       0x9e3779b97f4a7c15ull
 
 
 typedef struct {
@@ -61,194 +132,3297 @@ typedef struct {
     Key key;
     /* any value */
     Any value;
+    /* cached hash of key */
+    uint64_t hash;
+    /* cached length of key */
+    size_t len;
 
 } binding;
 
 
+/* chunk of key arena */
+typedef struct _arena_chunk {
+    /* previously filled chunk */
+    struct _arena_chunk *next;
+    /* bytes in use */
+    size_t used;
+    /* bytes available */
+    size_t size;
+    /* keys, each prefixed by its length and terminated by NUL */
+    size_t data[];
+
+} arena_chunk;
+
+
+/* bump allocator for keys owned by the hashmap */
+typedef struct {
+    /* chunk being filled */
+    arena_chunk *head;
+    /* words taken by keys of bindings and by removed keys */
+    size_t live;
+    size_t dead;
+
+} arena;
+
+
+/* allocations left behind by the writer that concurrent
+ * lookups may still read until they are reclaimed */
+typedef struct _retired {
+    /* previously retired allocations */
+    struct _retired *next;
+    /* control tags and bindings of a replaced hashtable */
+    int8_t *ctrl;
+    binding *bindings;
+    /* chunks of a replaced key arena */
+    arena_chunk *chunks;
+
+} retired;
+
+
 typedef struct {
     /* table size */
     size_t size;
+    /* count of slots marked deleted */
+    size_t deleted;
+    /* mode flags of owning hashmap */
+    int flags;
+    /* address keys are relative to, 0 unless
+     * the hashtable is served from a mapped image */
+    uintptr_t base;
+    /* shift taking the table index from the top
+     * bits of a 64 bit product in fibonacci mode */
+    int shift;
+    /* reciprocal of prime table size, 2^64 / size rounded down,
+     * taking the table index by multiplication instead of division */
+    uint64_t reciprocal;
+    /* control tags of slots and their clones */
+    int8_t *ctrl;
+    /* bindings, one per slot unless in compact mode,
+     * where they are entries in insertion order */
+    binding *bindings;
+    /* index of entry per slot in compact mode */
+    uint32_t *indices;
+    /* count of entries appended and room for entries */
+    size_t entries;
+    size_t capacity;
+
+} hashtable;
+
+
+/* position along the probe sequence of a hash */
+typedef struct {
+    /* home slot of hash */
+    size_t home;
+    /* first slot of group being probed */
+    size_t idx;
+    /* count of groups probed before */
+    size_t count;
+
+} probe;
+
+
+typedef struct {
     /* binding count */
     size_t load;
+    /* ratio of bindings to table size triggering a resize */
+    double load_factor;
+    /* factor by which the table size grows */
+    double growth_rate;
+    /* mode flags */
+    int flags;
+    /* hash function */
+    HashFunc hash;
+    /* hash function seed */
+    uint64_t seed;
     /* hashtable */
-    binding *table;
+    hashtable table;
+    /* hashtable being migrated during incremental
+     * resize, without any slots otherwise */
+    hashtable old;
+    /* slots of old hashtable migrated so far */
+    size_t migrated;
+    /* storage of owned keys */
+    arena keys;
+    /* storage of owned keys in old hashtable */
+    arena old_keys;
+    /* sequence of writer, odd while it modifies
+     * bindings or publishes a hashtable */
+    uint64_t seq;
+    /* allocations waiting for concurrent lookups to finish */
+    retired *retired;
+    /* mapped image serving the hashtable, NULL
+     * unless the hashmap was opened from a file */
+    void *image;
+    /* length of mapped image */
+    size_t image_size;
+#if defined(MAP_STATS)
+    /* count and cumulative seconds of resizes */
+    size_t resizes;
+    double resize_time;
+#endif
+    /* bindings in insertion order while the hashtable has no
+     * slots in small mode, only allocated in that mode */
+    binding small[];
 
 } hashmap;
 
 
+/* header of hashmap image, followed by the control tags, the bindings
+ * with keys given as offsets from the start of the image, and the keys
+ * each prefixed by its length and terminated by NUL */
+typedef struct {
+    /* IMAGE_MAGIC */
+    char magic[8];
+    /* sizes of word and binding the image was written with */
+    uint32_t word_size;
+    uint32_t binding_size;
+    /* mode flags */
+    uint64_t flags;
+    /* index of hash function in image_hashes and its seed */
+    uint64_t hash;
+    uint64_t seed;
+    /* table size, count of slots marked deleted and binding count */
+    uint64_t size;
+    uint64_t deleted;
+    uint64_t load;
+    /* ratio of bindings to table size triggering a resize */
+    double load_factor;
+    /* factor by which the table size grows */
+    double growth_rate;
+    /* offsets of control tags, bindings and keys */
+    uint64_t ctrl;
+    uint64_t bindings;
+    uint64_t keys;
+    /* length of image */
+    uint64_t length;
+
+} image_header;
+
+
 typedef struct {
     /* index of next binding in hashtable */
     size_t next;
+    /* index past the bindings of iterator, SIZE_MAX
+     * for all up to the end of the hashmap */
+    size_t end;
     /* address of hashmap to iterate */
     hashmap *map;
 
 } hashmap_iterator;
 
 
-/* hashing algorithm */
-static inline unsigned int
-hash (Key k)
+/* thread running a worker, first member of every kind of worker */
+typedef struct {
+    /* thread and whether it started */
+    pthread_t thread;
+    int started;
+
+} worker_thread;
+
+
+/* state shared by the workers of a bulk insertion */
+typedef struct {
+    /* hashmap to fill */
+    hashmap *map;
+    /* keys and values to insert */
+    const Key *keys;
+    const Any *values;
+    /* hashes and lengths of keys */
+    uint64_t *hashes;
+    size_t *lens;
+    /* indices of keys grouped by region of their home slot */
+    size_t *order;
+    /* slots per region, each filled by one worker */
+    size_t width;
+
+} bulk;
+
+
+/* worker of a bulk insertion */
+typedef struct {
+    /* thread running worker */
+    worker_thread thread;
+    /* state shared by all workers */
+    const bulk *shared;
+    /* keys hashed by worker */
+    size_t begin;
+    size_t end;
+    /* keys hashed by worker per region, turned into
+     * offsets into order, NULL unless filling regions */
+    size_t *offsets;
+    /* region of order filled by worker, keys left for
+     * insertion after all workers are moved to its front */
+    size_t first;
+    size_t last;
+    size_t deferred;
+    /* bindings added and deleted slots they took */
+    size_t inserted;
+    size_t reused;
+    /* keys owned by bindings added */
+    arena keys;
+    /* result of worker */
+    int ret;
+
+} bulk_worker;
+
+
+/* worker of a parallel foreach */
+typedef struct {
+    /* thread running worker */
+    worker_thread thread;
+    /* iterator over bindings of worker */
+    Iterator it;
+    /* function to call with context */
+    ForeachFunc fn;
+    void *ctx;
+
+} foreach_worker;
+
+
+/* read 8 bytes from possibly unaligned address */
+static inline uint64_t
+read64 (const uint8_t *p)
+{
+
+    uint64_t v;
+
+    memcpy (&v, p, sizeof (v));
+
+    return v;
+
+}
+
+
+/* read 4 bytes from possibly unaligned address */
+static inline uint64_t
+read32 (const uint8_t *p)
+{
+
+    uint32_t v;
+
+    memcpy (&v, p, sizeof (v));
+
+    return v;
+
+}
+
+
+/* rotate left */
+static inline uint64_t
+rotl (uint64_t x, int r)
+{
+
+    return (x << r) | (x >> (64 - r));
+
+}
+
+
+/* multiply to 128 bit and fold low and high half into the factors, so
+ * that a factor of 0 cannot wipe out the other one and with it the seed */
+static inline void
+mum (uint64_t *a, uint64_t *b)
+{
+
+#if defined(__SIZEOF_INT128__)
+    __extension__ unsigned __int128 r = (unsigned __int128) *a * *b;
+
+    *a ^= (uint64_t) r;
+    *b ^= (uint64_t) (r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl, lo = t + (rm1 << 32);
+
+    c += lo < t;
+
+    *a ^= lo;
+    *b ^= rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+
+}
+
+
+/* high half of 128 bit product */
+static inline uint64_t
+mul_high (uint64_t a, uint64_t b)
+{
+
+#if defined(__SIZEOF_INT128__)
+    __extension__ unsigned __int128 r = (unsigned __int128) a * b;
+
+    return (uint64_t) (r >> 64);
+#else
+    uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t) a, lb = (uint32_t) b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl, lo = t + (rm1 << 32);
+
+    c += lo < t;
+
+    return rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+
+}
+
+
+/* multiply and fold */
+static inline uint64_t
+mix (uint64_t a, uint64_t b)
+{
+
+    mum (&a, &b);
+
+    return a ^ b;
+
+}
+
+
+/* djb2, one byte per iteration */
+uint64_t
+map_hash_djb2 (const void *key, size_t len, uint64_t seed)
 {
 
-    unsigned int hash = 5381;
-    int c;
+    const uint8_t *p = key;
+
+    uint64_t hash = 5381 ^ seed;
 
-    while ( (c = *k++) )
-        hash = ((hash << 5) + hash) ^ c;
+    while (len--)
+        hash = ((hash << 5) + hash) ^ *p++;
 
     return hash;
 
 }
 
 
-/* find next prime after given number */
-static size_t
-next_prime (size_t n)
+/* wyhash (final 4) in its mode keeping factors, 16 bytes per iteration */
+uint64_t
+map_hash_wyhash (const void *key, size_t len, uint64_t seed)
+{
+
+    static const uint64_t secret[4] = {
+        0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+        0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+    };
+
+    const uint8_t *p = key;
+
+    uint64_t a, b, see1, see2;
+
+    size_t i = len;
+
+    seed ^= mix (seed ^ secret[0], secret[1]);
+
+    if (len <= 16) {
+
+        if (len >= 4) {
+            a = (read32 (p) << 32) | read32 (p + ((len >> 3) << 2));
+            b = (read32 (p + len - 4) << 32) | read32 (p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+
+    } else {
+
+        if (i > 48) {
+            see1 = see2 = seed;
+
+            do {
+                seed = mix (read64 (p) ^ secret[1], read64 (p + 8) ^ seed);
+                see1 = mix (read64 (p + 16) ^ secret[2], read64 (p + 24) ^ see1);
+                see2 = mix (read64 (p + 32) ^ secret[3], read64 (p + 40) ^ see2);
+
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+
+            seed ^= see1 ^ see2;
+        }
+
+        while (i > 16) {
+            seed = mix (read64 (p) ^ secret[1], read64 (p + 8) ^ seed);
+
+            p += 16;
+            i -= 16;
+        }
+
+        a = read64 (p + i - 16);
+        b = read64 (p + i - 8);
+
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+
+    mum (&a, &b);
+
+    return mix (a ^ secret[0] ^ len, b ^ secret[1]);
+
+}
+
+
+#define XXH_PRIME1  0x9e3779b185ebca87ull
+#define XXH_PRIME2  0xc2b2ae3d27d4eb4full
+#define XXH_PRIME3  0x165667b19e3779f9ull
+#define XXH_PRIME4  0x85ebca77c2b2ae63ull
+#define XXH_PRIME5  0x27d4eb2f165667c5ull
+
+
+/* xxh64 accumulator round */
+static inline uint64_t
+xxh_round (uint64_t acc, uint64_t input)
+{
+
+    acc += input * XXH_PRIME2;
+    acc = rotl (acc, 31);
+
+    return acc * XXH_PRIME1;
+
+}
+
+
+/* xxh64 accumulator merge */
+static inline uint64_t
+xxh_merge (uint64_t acc, uint64_t val)
+{
+
+    acc ^= xxh_round (0, val);
+
+    return acc * XXH_PRIME1 + XXH_PRIME4;
+
+}
+
+
+/* xxh64, 32 bytes per iteration */
+uint64_t
+map_hash_xxh64 (const void *key, size_t len, uint64_t seed)
+{
+
+    const uint8_t *p = key;
+    const uint8_t *end = p + len;
+
+    uint64_t v1, v2, v3, v4, h;
+
+    if (len >= 32) {
+        v1 = seed + XXH_PRIME1 + XXH_PRIME2;
+        v2 = seed + XXH_PRIME2;
+        v3 = seed;
+        v4 = seed - XXH_PRIME1;
+
+        do {
+            v1 = xxh_round (v1, read64 (p));
+            v2 = xxh_round (v2, read64 (p + 8));
+            v3 = xxh_round (v3, read64 (p + 16));
+            v4 = xxh_round (v4, read64 (p + 24));
+
+            p += 32;
+        } while (p + 32 <= end);
+
+        h = rotl (v1, 1) + rotl (v2, 7) + rotl (v3, 12) + rotl (v4, 18);
+        h = xxh_merge (h, v1);
+        h = xxh_merge (h, v2);
+        h = xxh_merge (h, v3);
+        h = xxh_merge (h, v4);
+    } else {
+        h = seed + XXH_PRIME5;
+    }
+
+    h += len;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxh_round (0, read64 (p));
+        h = rotl (h, 27) * XXH_PRIME1 + XXH_PRIME4;
+    }
+
+    if (p + 4 <= end) {
+        h ^= read32 (p) * XXH_PRIME1;
+        h = rotl (h, 23) * XXH_PRIME2 + XXH_PRIME3;
+
+        p += 4;
+    }
+
+    for (; p < end; ++p) {
+        h ^= *p * XXH_PRIME5;
+        h = rotl (h, 11) * XXH_PRIME1;
+    }
+
+    // avalanche
+    h ^= h >> 33;
+    h *= XXH_PRIME2;
+    h ^= h >> 29;
+    h *= XXH_PRIME3;
+    h ^= h >> 32;
+
+    return h;
+
+}
+
+
+/* siphash round over state */
+static inline void
+sip_round (uint64_t *v)
+{
+
+    v[0] += v[1];
+    v[1] = rotl (v[1], 13) ^ v[0];
+    v[0] = rotl (v[0], 32);
+    v[2] += v[3];
+    v[3] = rotl (v[3], 16) ^ v[2];
+    v[0] += v[3];
+    v[3] = rotl (v[3], 21) ^ v[0];
+    v[2] += v[1];
+    v[1] = rotl (v[1], 17) ^ v[2];
+    v[2] = rotl (v[2], 32);
+
+}
+
+
+/* siphash-1-3 keyed by seed, 8 bytes per iteration */
+uint64_t
+map_hash_siphash (const void *key, size_t len, uint64_t seed)
+{
+
+    const uint8_t *p = key;
+    const uint8_t *end = p + (len & ~(size_t) 7);
+
+    uint64_t v[4], m;
+
+    size_t i;
+
+    // 128 bit key of seed and its complement
+    v[0] = seed ^ 0x736f6d6570736575ull;
+    v[1] = ~seed ^ 0x646f72616e646f6dull;
+    v[2] = seed ^ 0x6c7967656e657261ull;
+    v[3] = ~seed ^ 0x7465646279746573ull;
+
+    for (; p < end; p += 8) {
+        m = read64 (p);
+
+        v[3] ^= m;
+        sip_round (v);
+        v[0] ^= m;
+    }
+
+    // remaining bytes with length in the top byte
+    m = (uint64_t) len << 56;
+
+    for (i = 0; i < (len & 7); ++i)
+        m |= (uint64_t) p[i] << (8 * i);
+
+    v[3] ^= m;
+    sip_round (v);
+    v[0] ^= m;
+
+    // finalization
+    v[2] ^= 0xff;
+    sip_round (v);
+    sip_round (v);
+    sip_round (v);
+
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+
+}
+
+
+/* seed drawn from the random secret of the process
+ * and a counter so that every call gets its own */
+uint64_t
+map_random_seed (void)
+{
+
+    static uint64_t secret, counter;
+
+    uint64_t s;
+
+    FILE *f;
+
+    s = __atomic_load_n (&secret, __ATOMIC_RELAXED);
+
+    // racing first calls each store a random secret of their own
+    if (!s) {
+        f = fopen ("/dev/urandom", "rb");
+
+        // fall back on time and address of the secret under ASLR
+        if (!f || fread (&s, sizeof (s), 1, f) != 1)
+            s = mix ((uint64_t) time (NULL), (uintptr_t) &secret);
+
+        if (f)
+            fclose (f);
+
+        s |= 1;
+
+        __atomic_store_n (&secret, s, __ATOMIC_RELAXED);
+    }
+
+    return mix (s, FIBONACCI * __atomic_add_fetch (&counter, 1, __ATOMIC_RELAXED));
+
+}
+
+
+/* hash key of given length with hash function of hashmap */
+static inline uint64_t
+hash (const hashmap *map, const void *key, size_t len)
+{
+
+    return map->hash (key, len, map->seed);
+
+}
+
+
+/* hash of binary key of given length under hash function and seed of hashmap */
+uint64_t
+map_hash_key (const Hashmap hm, const void *key, size_t len)
+{
+
+    return hash (hm, key, len);
+
+}
+
+
+/* compare keys of equal length a word at a time */
+static inline int
+keys_equal (const uint8_t *a, const uint8_t *b, size_t len)
+{
+
+    size_t i;
+
+    if (len >= 8) {
+
+        for (i = 0; i + 8 < len; i += 8) {
+
+            if (read64 (a + i) != read64 (b + i))
+                return 0;
+
+        }
+
+        // last word overlaps the previous one
+        return read64 (a + len - 8) == read64 (b + len - 8);
+    }
+
+    if (len >= 4)
+        return read32 (a) == read32 (b) && read32 (a + len - 4) == read32 (b + len - 4);
+
+    for (i = 0; i < len; ++i) {
+
+        if (a[i] != b[i])
+            return 0;
+
+    }
+
+    return 1;
+
+}
+
+
+/* address of key of binding in hashtable, keys of a hashtable
+ * served from a mapped image are offsets from its start */
+static inline Key
+key_of (const hashtable *t, const binding *b)
+{
+
+    return (Key) (t->base + (uintptr_t) b->key);
+
+}
+
+/* binding held by slot, found by way of its index in compact mode */
+static inline binding *
+slot_binding (const hashtable *t, size_t idx)
+{
+
+    if (t->flags & MAP_COMPACT)
+        return &t->bindings[t->indices[idx]];
+
+    return &t->bindings[idx];
+
+}
+
+/* store binding in slot, appending it to the entries in compact mode */
+static inline void
+set_binding (hashtable *t, size_t idx, const binding *b)
+{
+
+    if (t->flags & MAP_COMPACT) {
+        t->indices[idx] = (uint32_t) t->entries;
+        t->bindings[t->entries++] = *b;
+    } else
+        t->bindings[idx] = *b;
+
+}
+
+/* move binding from one slot to another */
+static inline void
+move_binding (hashtable *t, size_t to, size_t from)
+{
+
+    if (t->flags & MAP_COMPACT)
+        t->indices[to] = t->indices[from];
+    else
+        t->bindings[to] = t->bindings[from];
+
+}
+
+/* test if binding in hashtable matches key with given hash and length */
+static inline int
+matches (const hashtable *t, const binding *b, const void *key, uint64_t h, size_t len)
+{
+
+    // compare cached hash and length first to
+    // avoid touching key memory on mismatches
+    return b->hash == h && b->len == len && keys_equal ((const uint8_t *) key_of (t, b), key, len);
+
+}
+
+
+/* home slot of hash, derived from bits not used for the tag */
+static inline size_t
+home (const hashtable *t, uint64_t h)
+{
+
+    if (t->flags & MAP_FIBONACCI)
+        return (size_t) (((h >> 7) * FIBONACCI) >> t->shift);
+
+    if (t->flags & MAP_POW2)
+        return (size_t) (h >> 7) & (t->size - 1);
+
+    // remainder by prime size without division, which robin hood mode
+    // would pay on every probe step, the quotient estimated through
+    // the reciprocal falls short by at most one, which one step corrects
+    h = (h >> 7) - mul_high (h >> 7, t->reciprocal) * t->size;
+
+    return (size_t) (h >= t->size ? h - t->size : h);
+
+}
+
+
+/* set control tag of slot and of its clone */
+static inline void
+set_ctrl (hashtable *t, size_t idx, int8_t tag)
+{
+
+    ctrl_set (t->ctrl, t->size, idx, tag);
+
+}
+
+
+/* allocate empty table of given size */
+static int
+alloc_table (hashtable *t, size_t size)
+{
+
+    int8_t *ctrl;
+    binding *bindings = NULL;
+    uint32_t *indices = NULL;
+
+    ctrl = ctrl_alloc (size);
+
+    if (!ctrl)
+        return MAP_OUT_OF_MEMORY;
+
+    // entries are allocated as they are appended
+    if (t->flags & MAP_COMPACT)
+        indices = malloc (size * sizeof (uint32_t));
+    else
+        bindings = malloc (size * sizeof (binding));
+
+    if (!bindings && !indices) {
+        // free previously allocated resources
+        free (ctrl);
+
+        return MAP_OUT_OF_MEMORY;
+    }
+
+    t->shift = table_shift (size);
+    t->reciprocal = UINT64_MAX / size;
+    t->size = size;
+    t->deleted = 0;
+    t->base = 0;
+    t->ctrl = ctrl;
+    t->bindings = bindings;
+    t->indices = indices;
+    t->entries = 0;
+    t->capacity = 0;
+
+    return MAP_OK;
+
+}
+
+/* make room for given count of entries in compact mode,
+ * at least doubling the room to amortize appending */
+static int
+reserve_entries (hashtable *t, size_t count)
+{
+
+    size_t capacity;
+
+    binding *bindings;
+
+    if (count <= t->capacity)
+        return MAP_OK;
+
+    // entries must be reachable by 32 bit indices
+    if (count > UINT32_MAX)
+        return MAP_OUT_OF_MEMORY;
+
+    capacity = t->capacity * 2;
+
+    if (capacity < count)
+        capacity = count;
+
+    if (capacity > UINT32_MAX)
+        capacity = UINT32_MAX;
+
+    bindings = realloc (t->bindings, capacity * sizeof (binding));
+
+    if (!bindings)
+        return MAP_OUT_OF_MEMORY;
+
+    t->bindings = bindings;
+    t->capacity = capacity;
+
+    return MAP_OK;
+
+}
+
+
+/* find next prime after given number */
+static size_t
+next_prime (size_t n)
+{
+
+    for (;; ++n) {
+
+        if (n % 2 == 0 || n % 3 == 0)
+            goto NEXT;
+
+        size_t div = 6;
+        while (div * div - (div << 1) + 1 <= n) {
+            if (n % (div - 1) == 0 || n % (div + 1) == 0)
+                goto NEXT;
+
+            div += 6;
+        }
+
+        return n;
+
+NEXT:
+        continue;
+
+    }
+}
+
+/* table size of at least given number of slots */
+static size_t
+next_size (const hashtable *t, size_t n)
+{
+
+    // groups must not wrap around onto themselves
+    if (n < GROUP_WIDTH)
+        n = GROUP_WIDTH;
+
+    if (!(t->flags & (MAP_POW2 | MAP_FIBONACCI)))
+        return next_prime (n);
+
+    return table_size (n);
+
+}
+
+/* start probe sequence at home slot of hash */
+static inline void
+probe_init (const hashtable *t, uint64_t h, probe *p)
+{
+
+    p->home = home (t, h);
+    p->idx = p->home;
+    p->count = 0;
+
+}
+
+/* move probe sequence on to next group, 0 once it covered every slot.
+ * quadratic and triangular offsets are not guaranteed to reach every
+ * group, so once as many groups as the table holds have been probed
+ * the sequence sweeps linearly over the table from home slot again */
+static inline int
+probe_next (const hashtable *t, probe *p)
+{
+
+    size_t step;
+
+    size_t groups = (t->size + GROUP_WIDTH - 1) / GROUP_WIDTH;
+
+    ++p->count;
+
+    // linear sequence covered every slot
+    if (p->count == groups && !(t->flags & (MAP_QUADRATIC | MAP_TRIANGULAR)))
+        return 0;
+
+    // linear sweep covered every slot
+    if (p->count == 2 * groups)
+        return 0;
+
+    if (p->count == groups) {
+        p->idx = p->home;
+
+        return 1;
+    }
+
+    // offsets of i * i groups by steps of 2i - 1 groups
+    if (p->count < groups && (t->flags & MAP_QUADRATIC))
+        step = GROUP_WIDTH * (2 * p->count - 1) % t->size;
+    // offsets of i * (i + 1) / 2 groups by steps of i groups
+    else if (p->count < groups && (t->flags & MAP_TRIANGULAR))
+        step = GROUP_WIDTH * p->count % t->size;
+    else
+        step = GROUP_WIDTH;
+
+    p->idx = WRAP (p->idx + step, t->size);
+
+    return 1;
+
+}
+
+/* find slot with matching key */
+static int
+find_key (const hashtable *t, const void *key, uint64_t h, size_t len, size_t *index)
+{
+
+    unsigned int mask;
+
+    size_t slot;
+
+    probe p;
+
+    int8_t tag = CTRL_TAG (h);
+
+    // get slot index for key
+    probe_init (t, h, &p);
+
+    // probing over groups
+    do {
+
+        // test every slot in group whose tag matches
+        for (mask = group_match (t->ctrl + p.idx, tag); mask; mask &= mask - 1) {
+
+            slot = WRAP (p.idx + lowest_bit (mask), t->size);
+
+            if (matches (t, slot_binding (t, slot), key, h, len)) {
+                // retreive index
+                *index = slot;
+
+                return MAP_OK;
+            }
+        }
+
+        // group has a slot without binding, key cannot be further down
+        if (group_match_empty (t->ctrl + p.idx))
+            break;
+
+    } while (probe_next (t, &p));
+
+    return MAP_KEY_NOT_FOUND;
+
+}
+
+/* find first free slot along the probe sequence of hash, the load
+ * factor keeps a free slot within reach of every probe sequence */
+static size_t
+find_free_slot (const hashtable *t, uint64_t h)
+{
+
+    unsigned int mask;
+
+    probe p;
+
+    // get slot index for hash
+    probe_init (t, h, &p);
+
+    // probing over groups until one has a free slot
+    while (!(mask = group_match_free (t->ctrl + p.idx)))
+        probe_next (t, &p);
+
+    return WRAP (p.idx + lowest_bit (mask), t->size);
+
+}
+
+/* find slot with matching key like find_key, or else the first free
+ * slot along its probe sequence, as long as all groups probed lie in
+ * the slots from lo up to hi, MAP_PROBING_FAILED once it leaves them */
+static int
+find_in_region (const hashtable *t, const void *key, uint64_t h, size_t len,
+                size_t lo, size_t hi, size_t *index)
+{
+
+    unsigned int mask;
+
+    size_t slot, vacant = SIZE_MAX;
+
+    probe p;
+
+    int8_t tag = CTRL_TAG (h);
+
+    // get slot index for key
+    probe_init (t, h, &p);
+
+    do {
+
+        // group reaches into slots of another region
+        if (p.idx < lo || p.idx + GROUP_WIDTH > hi)
+            return MAP_PROBING_FAILED;
+
+        // test every slot in group whose tag matches
+        for (mask = group_match (t->ctrl + p.idx, tag); mask; mask &= mask - 1) {
+
+            slot = p.idx + lowest_bit (mask);
+
+            if (matches (t, slot_binding (t, slot), key, h, len)) {
+                // retreive index
+                *index = slot;
+
+                return MAP_OK;
+            }
+        }
+
+        // remember first free slot
+        if (vacant == SIZE_MAX && (mask = group_match_free (t->ctrl + p.idx)))
+            vacant = p.idx + lowest_bit (mask);
+
+        // group has a slot without binding, key cannot be further down
+        if (group_match_empty (t->ctrl + p.idx)) {
+            *index = vacant;
+
+            return MAP_KEY_NOT_FOUND;
+        }
+
+    } while (probe_next (t, &p));
+
+    return MAP_PROBING_FAILED;
+
+}
+
+/* distance of binding at index from its home slot */
+static inline size_t
+distance (const hashtable *t, size_t idx)
+{
+
+    size_t h = home (t, slot_binding (t, idx)->hash);
+
+    return idx >= h ? idx - h : idx + t->size - h;
+
+}
+
+/* insert binding known not to be in table at first free slot */
+static binding *
+insert_linear (hashtable *t, const binding *b)
+{
+
+    size_t idx = find_free_slot (t, b->hash);
+
+    // reuse deleted slot, removed entries are counted instead in compact mode
+    if (ctrl_claim (t->ctrl, t->size, idx, CTRL_TAG (b->hash)) && !(t->flags & MAP_COMPACT))
+        --t->deleted;
+
+    set_binding (t, idx, b);
+
+    return slot_binding (t, idx);
+
+}
+
+/* insert binding known not to be in table in front of the
+ * first binding that is closer to its home slot, shifting
+ * the remaining bindings of the run one slot further */
+static binding *
+insert_robin_hood (hashtable *t, const binding *b)
+{
+
+    size_t dist, idx, pos, prev;
+
+    // get slot index for hash
+    idx = home (t, b->hash);
+
+    // find slot that is empty or holds a richer binding
+    for (dist = 0; t->ctrl[idx] >= 0 && distance (t, idx) >= dist; ++dist)
+        idx = WRAP (idx + 1, t->size);
+
+    pos = idx;
+
+    // find end of run, the load factor keeps a free slot
+    for (; t->ctrl[idx] >= 0; idx = WRAP (idx + 1, t->size));
+
+    // shift bindings towards end of run
+    for (; idx != pos; idx = prev) {
+
+        prev = idx ? idx - 1 : t->size - 1;
+
+        set_ctrl (t, idx, t->ctrl[prev]);
+        move_binding (t, idx, prev);
+
+    }
+
+    // insert binding
+    set_ctrl (t, pos, CTRL_TAG (b->hash));
+    set_binding (t, pos, b);
+
+    return slot_binding (t, pos);
+
+}
+
+/* insert binding known not to be in table */
+static inline binding *
+insert_binding (hashtable *t, const binding *b)
+{
+
+    if (t->flags & MAP_ROBIN_HOOD)
+        return insert_robin_hood (t, b);
+
+    return insert_linear (t, b);
+
+}
+
+/* remove binding at index by tagging the slot deleted */
+static void
+remove_linear (hashtable *t, size_t idx)
+{
+
+    // removed entries are counted instead in compact mode
+    if (ctrl_release (t->ctrl, t->size, idx) && !(t->flags & MAP_COMPACT))
+        ++t->deleted;
+
+}
+
+/* remove binding at index by shifting back the
+ * following bindings that are not in their home slot */
+static void
+remove_backward_shift (hashtable *t, size_t idx)
+{
+
+    size_t next;
+
+    for (next = WRAP (idx + 1, t->size);
+         t->ctrl[next] >= 0 && distance (t, next) > 0;
+         idx = next, next = WRAP (next + 1, t->size)) {
+
+        set_ctrl (t, idx, t->ctrl[next]);
+        move_binding (t, idx, next);
+
+    }
+
+    set_ctrl (t, idx, CTRL_EMPTY);
+
+}
+
+/* words taken by key of given length in arena, length
+ * prefix, key and terminating NUL in whole words */
+static inline size_t
+key_words (size_t len)
+{
+
+    return 1 + (len + sizeof (size_t)) / sizeof (size_t);
+
+}
+
+/* copy key into arena */
+static Key
+arena_store (arena *a, const void *key, size_t len)
+{
+
+    Key copy;
+    arena_chunk *chunk;
+
+    size_t size, words;
+
+    words = key_words (len);
+
+    if (!a->head || a->head->size - a->head->used < words) {
+
+        // double chunk size up to maximum
+        size = a->head ? 2 * a->head->size : ARENA_CHUNK_SIZE / sizeof (size_t);
+
+        if (size > ARENA_CHUNK_MAX_SIZE / sizeof (size_t))
+            size = ARENA_CHUNK_MAX_SIZE / sizeof (size_t);
+
+        // oversized key gets a chunk of its own
+        if (size < words)
+            size = words;
+
+        chunk = malloc (sizeof (arena_chunk) + size * sizeof (size_t));
+
+        if (!chunk)
+            return NULL;
+
+        chunk->next = a->head;
+        chunk->used = 0;
+        chunk->size = size;
+
+        a->head = chunk;
+    }
+
+    chunk = a->head;
+
+    // prefix length
+    chunk->data[chunk->used] = len;
+
+    copy = memcpy (chunk->data + chunk->used + 1, key, len);
+    copy[len] = '\0';
+
+    chunk->used += words;
+    a->live += words;
+
+    return copy;
+
+}
+
+/* count key of given length in arena as removed */
+static inline void
+arena_release (arena *a, size_t len)
+{
+
+    a->live -= key_words (len);
+    a->dead += key_words (len);
+
+}
+
+/* delete all chunks of arena */
+static void
+arena_free (arena *a)
+{
+
+    arena_chunk *next;
+
+    for (; a->head; a->head = next) {
+        next = a->head->next;
+
+        free (a->head);
+    }
+
+    a->live = 0;
+    a->dead = 0;
+
+}
+
+/* delete all keys of arena, keeping the current chunk for reuse */
+static void
+arena_clear (arena *a)
+{
+
+    arena_chunk *head = a->head;
+
+    a->live = 0;
+    a->dead = 0;
+
+    if (!head)
+        return;
+
+    a->head = head->next;
+    arena_free (a);
+
+    head->next = NULL;
+    head->used = 0;
+
+    a->head = head;
+
+}
+
+/* move all chunks of an arena to another */
+static void
+arena_merge (arena *a, arena *from)
+{
+
+    arena_chunk *tail;
+
+    if (!from->head)
+        return;
+
+    // chunk being filled stays in front
+    for (tail = from->head; tail->next; tail = tail->next);
+
+    tail->next = a->head;
+    a->head = from->head;
+    a->live += from->live;
+    a->dead += from->dead;
+
+    from->head = NULL;
+    from->live = 0;
+    from->dead = 0;
+
+}
+
+/* move keys of all bindings in given hashtable into a fresh arena,
+ * leaving out the space of removed keys, the previous arena is
+ * handed to retired allocations if given instead of being freed */
+static void
+compact (hashmap *map, hashtable *t, retired *r)
+{
+
+    size_t i, n, moved;
+
+    Key key;
+    binding *b;
+    arena fresh = { NULL, 0, 0 };
+
+    // bindings held inline in small mode are dense
+    n = t->size ? t->size : map->load;
+
+    for (i = 0; i < n; ++i) {
+
+        if (t->size && t->ctrl[i] < 0)
+            continue;
+
+        b = slot_binding (t, i);
+        key = arena_store (&fresh, b->key, b->len);
+
+        if (!key) {
+            // out of memory, keep keys spread over both arenas
+            // and count the originals of those moved as removed
+            moved = fresh.live;
+
+            arena_merge (&map->keys, &fresh);
+
+            map->keys.live -= moved;
+            map->keys.dead += moved;
+
+            return;
+        }
+
+        b->key = key;
+    }
+
+    // concurrent lookups may still compare keys of previous arena
+    if (r) {
+        r->chunks = map->keys.head;
+        map->keys.head = NULL;
+    }
+
+    arena_free (&map->keys);
+
+    map->keys = fresh;
+
+}
+
+/* enter modification visible to concurrent lookups,
+ * which retry until it is left */
+static inline void
+write_begin (hashmap *map)
+{
+
+    if (!(map->flags & MAP_CONCURRENT_READS))
+        return;
+
+    __atomic_store_n (&map->seq, map->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+
+}
+
+/* leave modification visible to concurrent lookups */
+static inline void
+write_end (hashmap *map)
+{
+
+    if (!(map->flags & MAP_CONCURRENT_READS))
+        return;
+
+    __atomic_store_n (&map->seq, map->seq + 1, __ATOMIC_RELEASE);
+
+}
+
+/* compact key arena of hashmap in place once removed keys outweigh
+ * live ones, its chunks are retired if concurrent lookups may still
+ * compare keys in them, which retry since the bindings change */
+static void
+purge_keys (hashmap *map)
+{
+
+    retired *r = NULL;
+
+    if (map->keys.dead < ARENA_PURGE_MIN || map->keys.dead <= map->keys.live)
+        return;
+
+    // out of memory, try again on a later removal
+    if ((map->flags & MAP_CONCURRENT_READS) && !(r = calloc (1, sizeof (retired))))
+        return;
+
+    write_begin (map);
+    compact (map, &map->table, r);
+    write_end (map);
+
+    if (r) {
+        r->next = map->retired;
+
+        map->retired = r;
+    }
+
+}
+
+/* sequence of writer outside of a modification */
+static inline uint64_t
+read_begin (const hashmap *map)
+{
+
+    uint64_t seq;
+
+    while ((seq = __atomic_load_n (&map->seq, __ATOMIC_ACQUIRE)) & 1);
+
+    return seq;
+
+}
+
+/* test if writer interfered with reads since given sequence */
+static inline int
+read_retry (const hashmap *map, uint64_t seq)
+{
+
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n (&map->seq, __ATOMIC_RELAXED) != seq;
+
+}
+
+/* free allocations retired by the writer */
+static void
+reclaim (hashmap *map)
+{
+
+    arena chunks;
+    retired *next;
+
+    for (; map->retired; map->retired = next) {
+        next = map->retired->next;
+
+        chunks.head = map->retired->chunks;
+        arena_free (&chunks);
+
+        free (map->retired->ctrl);
+        free (map->retired->bindings);
+        free (map->retired);
+    }
+
+}
+
+/* delete hashtable */
+static void
+free_table (hashtable *t)
+{
+
+    free (t->ctrl);
+    free (t->bindings);
+    free (t->indices);
+
+    t->size = 0;
+    t->deleted = 0;
+    t->ctrl = NULL;
+    t->bindings = NULL;
+    t->indices = NULL;
+    t->entries = 0;
+    t->capacity = 0;
+
+}
+
+/* hashtable serves the bindings held inline in small mode */
+static inline int
+is_small (const hashmap *map)
+{
+
+    return !map->table.size;
+
+}
+
+/* serve bindings from inline storage of hashmap, which
+ * are dense and reached by index even in compact mode */
+static void
+init_small (hashmap *map)
+{
+
+    map->table.size = 0;
+    map->table.deleted = 0;
+    map->table.flags = map->flags & ~MAP_COMPACT;
+    map->table.base = 0;
+    map->table.shift = 0;
+    map->table.reciprocal = 0;
+    map->table.ctrl = NULL;
+    map->table.bindings = map->small;
+    map->table.indices = NULL;
+    map->table.entries = 0;
+    map->table.capacity = 0;
+
+}
+
+/* table size after growing hashtable by growth rate */
+static size_t
+grown_size (const hashmap *map)
+{
+
+    size_t size = map->table.size * map->growth_rate;
+
+    return next_size (&map->table, size > map->table.size ? size : map->table.size + 1);
+
+}
+
+/* table size holding given count of bindings below load factor */
+static size_t
+fitting_size (const hashmap *map, size_t count)
+{
+
+    return next_size (&map->table, count / map->load_factor + 1);
+
+}
+
+/* rehash all keys into a hashtable of given size, built aside
+ * and published at once so that concurrent lookups can go on
+ * in the previous hashtable, which is retired until reclaimed */
+static int
+rehash (hashmap *map, size_t size)
+{
+
+    int ret;
+
+    size_t i, count;
+
+    retired *r = NULL;
+
+    hashtable old = map->table;
+    hashtable fresh = map->table;
+
+    if ((map->flags & MAP_CONCURRENT_READS) && !(r = calloc (1, sizeof (retired))))
+        return MAP_OUT_OF_MEMORY;
+
+    // allocate new table, in compact mode even when leaving small mode
+    fresh.flags = map->flags;
+    ret = alloc_table (&fresh, size);
+
+    if (ret != MAP_OK) {
+        // free previously allocated resources
+        free (r);
+
+        return ret;
+    }
+
+    if (map->flags & MAP_COMPACT) {
+        // room for entries up to the load factor, removed ones are left out
+        count = map->load_factor * size + 1;
+
+        ret = reserve_entries (&fresh, count > map->load ? count : map->load);
+
+        if (ret != MAP_OK) {
+            // free previously allocated resources
+            free (fresh.ctrl);
+            free (fresh.indices);
+            free (r);
+
+            return ret;
+        }
+    }
+
+    if (is_small (map)) {
+        // rehash bindings held inline in insertion order
+        for (i = 0; i < map->load; ++i)
+            insert_binding (&fresh, &map->small[i]);
+    } else if (map->flags & MAP_COMPACT) {
+        // rehash in insertion order
+        for (i = 0; i < old.entries; ++i) {
+
+            if (old.bindings[i].len != ENTRY_REMOVED)
+                insert_binding (&fresh, &old.bindings[i]);
+        }
+    } else {
+        // rehash
+        for (i = 0; i < old.size; ++i) {
+
+            // slot at index has binding, reinsert by cached hash
+            if (old.ctrl[i] >= 0)
+                insert_binding (&fresh, &old.bindings[i]);
+        }
+    }
+
+    if (map->flags & MAP_OWN_KEYS)
+        compact (map, &fresh, r);
+
+    // publish
+    write_begin (map);
+    map->table = fresh;
+    write_end (map);
+
+    // inline storage is part of the hashmap
+    if (!old.size)
+        old.bindings = NULL;
+
+    if (r) {
+        r->ctrl = old.ctrl;
+        r->bindings = old.bindings;
+        r->next = map->retired;
+
+        map->retired = r;
+    } else {
+        free (old.ctrl);
+        free (old.bindings);
+        free (old.indices);
+    }
+
+    return MAP_OK;
+
+}
+
+/* move bindings of hashtable back into inline storage of the hashmap
+ * in small mode, in insertion order if kept, and retire the hashtable */
+static int
+rehash_small (hashmap *map)
+{
+
+    size_t i, n;
+
+    retired *r = NULL;
+
+    hashtable old = map->table;
+
+    if ((map->flags & MAP_CONCURRENT_READS) && !(r = calloc (1, sizeof (retired))))
+        return MAP_OUT_OF_MEMORY;
+
+    // inline storage is not published, concurrent lookups cannot see it
+    if (map->flags & MAP_COMPACT) {
+        for (i = 0, n = 0; i < old.entries; ++i) {
+
+            if (old.bindings[i].len != ENTRY_REMOVED)
+                map->small[n++] = old.bindings[i];
+        }
+    } else {
+        for (i = 0, n = 0; i < old.size; ++i) {
+
+            if (old.ctrl[i] >= 0)
+                map->small[n++] = old.bindings[i];
+        }
+    }
+
+    // publish
+    write_begin (map);
+    init_small (map);
+    write_end (map);
+
+    if (r) {
+        r->ctrl = old.ctrl;
+        r->bindings = old.bindings;
+        r->next = map->retired;
+
+        map->retired = r;
+    } else {
+        free (old.ctrl);
+        free (old.bindings);
+        free (old.indices);
+    }
+
+    return MAP_OK;
+
+}
+
+#if defined(MAP_STATS)
+/* seconds since arbitrary point in time */
+static double
+seconds (void)
+{
+
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+
+}
+#endif
+
+/* rehash all keys into a hashtable of given size, counted in statistics */
+static int
+resize (hashmap *map, size_t size)
+{
+
+#if defined(MAP_STATS)
+    int ret;
+
+    double start = seconds ();
+
+    ret = rehash (map, size);
+
+    map->resize_time += seconds () - start;
+
+    if (ret == MAP_OK)
+        ++map->resizes;
+
+    return ret;
+#else
+    return rehash (map, size);
+#endif
+
+}
+
+/* move given number of slots from old hashtable to hashtable */
+static int
+migrate (hashmap *map, size_t count)
+{
+
+    size_t i;
+
+    binding b;
+
+    for (; count && map->migrated < map->old.size; --count) {
+
+        i = map->migrated;
+
+        // slot at index has binding, reinsert by cached hash
+        if (map->old.ctrl[i] >= 0) {
+
+            b = map->old.bindings[i];
+
+            // move owned key over to arena of hashtable
+            if ((map->flags & MAP_OWN_KEYS) && !(b.key = arena_store (&map->keys, b.key, b.len)))
+                return MAP_OUT_OF_MEMORY;
+
+            insert_binding (&map->table, &b);
+
+            // lookups in old hashtable must skip migrated binding
+            set_ctrl (&map->old, i, CTRL_DELETED);
+        }
+
+        ++map->migrated;
+
+    }
+
+    // old hashtable drained
+    if (map->old.size && map->migrated == map->old.size) {
+        free_table (&map->old);
+        arena_free (&map->old_keys);
+    }
+
+    return MAP_OK;
+
+}
+
+/* move a bounded number of slots from old hashtable to hashtable */
+static inline int
+migrate_step (hashmap *map)
+{
+
+    if (!map->old.size)
+        return MAP_OK;
+
+    return migrate (map, MIGRATION_STEP);
+
+}
+
+/* rehash all bindings into a hashtable of given size, either
+ * at once or incrementally on subsequent operations */
+static int
+grow (hashmap *map, size_t size)
+{
+
+    int ret;
+
+    // bindings held inline are too few to migrate
+    if (!(map->flags & MAP_INCREMENTAL) || is_small (map))
+        return resize (map, size);
+
+    // finish pending migration
+    ret = migrate (map, SIZE_MAX);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    // hashtable becomes old hashtable to be migrated
+    map->old = map->table;
+    map->migrated = 0;
+
+    ret = alloc_table (&map->table, size);
+
+    if (ret != MAP_OK) {
+        // restore
+        map->table = map->old;
+        map->old.size = 0;
+        map->old.ctrl = NULL;
+        map->old.bindings = NULL;
+
+        return ret;
+    }
+
+    // keys are moved to a fresh arena along with their bindings
+    map->old_keys = map->keys;
+    map->keys.head = NULL;
+    map->keys.live = 0;
+    map->keys.dead = 0;
+
+    STAT (++map->resizes);
+
+    return MAP_OK;
+
+}
+
+/* find slot with matching key in hashtable or old hashtable */
+static hashtable *
+find (hashmap *map, const void *key, uint64_t h, size_t len, size_t *index)
+{
+
+    size_t i;
+
+    // scan bindings held inline
+    if (is_small (map)) {
+
+        for (i = 0; i < map->load; ++i) {
+
+            if (matches (&map->table, &map->small[i], key, h, len)) {
+                *index = i;
+
+                return &map->table;
+            }
+        }
+
+        return NULL;
+    }
+
+    if (find_key (&map->table, key, h, len, index) == MAP_OK)
+        return &map->table;
+
+    if (map->old.size && find_key (&map->old, key, h, len, index) == MAP_OK)
+        return &map->old;
+
+    return NULL;
+
+}
+
+/* find value of key like find, but without any writes to the hashmap,
+ * validating reads against the sequence of a concurrent writer and
+ * starting over whenever the writer interfered */
+static int
+read_key (const hashmap *map, const void *key, uint64_t h, size_t len, Any *value)
+{
+
+    unsigned int mask;
+
+    uint64_t seq;
+
+    size_t slot, count;
+
+    Key k;
+    Any v;
+    hashtable t;
+    probe p;
+
+    int8_t tag = CTRL_TAG (h);
+
+RETRY:
+    seq = read_begin (map);
+
+    // snapshot of hashtable is consistent if no hashtable was published meanwhile
+    t = map->table;
+    count = map->load;
+
+    if (read_retry (map, seq))
+        goto RETRY;
+
+    // scan bindings held inline, up to the count at the snapshot
+    if (!t.size) {
+
+        for (slot = 0; slot < count && slot < SMALL_SIZE; ++slot) {
+
+            if (t.bindings[slot].hash != h || t.bindings[slot].len != len)
+                continue;
+
+            k = key_of (&t, &t.bindings[slot]);
+            v = t.bindings[slot].value;
+
+            // key must belong to binding before touching its memory
+            if (read_retry (map, seq))
+                goto RETRY;
+
+            if (keys_equal ((const uint8_t *) k, key, len)) {
+
+                if (read_retry (map, seq))
+                    goto RETRY;
+
+                // retreive value
+                *value = v;
+
+                return MAP_OK;
+            }
+        }
+
+        if (read_retry (map, seq))
+            goto RETRY;
+
+        return MAP_KEY_NOT_FOUND;
+    }
+
+    // get slot index for key
+    probe_init (&t, h, &p);
+
+    // probing over groups
+    do {
+
+        // test every slot in group whose tag matches
+        for (mask = group_match (t.ctrl + p.idx, tag); mask; mask &= mask - 1) {
+
+            slot = WRAP (p.idx + lowest_bit (mask), t.size);
+
+            if (t.bindings[slot].hash != h || t.bindings[slot].len != len)
+                continue;
+
+            k = key_of (&t, &t.bindings[slot]);
+            v = t.bindings[slot].value;
+
+            // key must belong to binding before touching its memory
+            if (read_retry (map, seq))
+                goto RETRY;
+
+            if (keys_equal ((const uint8_t *) k, key, len)) {
+
+                if (read_retry (map, seq))
+                    goto RETRY;
+
+                // retreive value
+                *value = v;
+
+                return MAP_OK;
+            }
+        }
+
+        // group has a slot without binding, key cannot be further down
+        if (group_match_empty (t.ctrl + p.idx))
+            break;
+
+    } while (probe_next (&t, &p));
+
+    if (read_retry (map, seq))
+        goto RETRY;
+
+    return MAP_KEY_NOT_FOUND;
+
+}
+
+/* retreive value of key, without locking against a
+ * concurrent writer if hashmap is in that mode */
+static int
+lookup (hashmap *map, const void *key, uint64_t h, size_t len, Any *value)
+{
+
+    size_t idx;
+
+    hashtable *t;
+
+    if (map->flags & MAP_CONCURRENT_READS)
+        return read_key (map, key, h, len, value);
+
+    if (!(t = find (map, key, h, len, &idx)))
+        return MAP_KEY_NOT_FOUND;
+
+    // retreive value
+    *value = slot_binding (t, idx)->value;
+
+    return MAP_OK;
+
+}
+
+/* create new binding of key with given hash known not to be in
+ * hashmap, growing the table first if needed, and retreive it,
+ * the value is passed through function unless null once nothing
+ * can fail anymore, so that it never runs for a binding not made */
+static int
+add (hashmap *map, const void *key, uint64_t h, size_t len, Any value, UpsertFunc fn, void *ctx, binding **added)
+{
+
+    int ret;
+
+    size_t size;
+
+    binding b;
+
+    b.key = (Key) key;
+    b.value = value;
+    b.hash = h;
+    b.len = len;
+
+    size = map->table.size;
+
+    // bindings outgrow inline storage, or bindings and deleted slots exceed threshold
+    if (is_small (map) ? map->load == SMALL_SIZE : table_full (size, map->load, map->table.deleted, map->load_factor)) {
+        // grow table unless mostly deleted slots need to be purged
+        if (table_grows (size, map->load, map->load_factor, map->growth_rate))
+            ret = grow (map, grown_size (map));
+        else
+            ret = grow (map, size);
+
+        if (ret != MAP_OK)
+            return ret;
+    }
+
+    // make room to append entry
+    if ((map->flags & MAP_COMPACT) && !is_small (map) && reserve_entries (&map->table, map->table.entries + 1) != MAP_OK)
+        return MAP_OUT_OF_MEMORY;
+
+    // take ownership of a copy of key
+    if ((map->flags & MAP_OWN_KEYS) && !(b.key = arena_store (&map->keys, key, b.len)))
+        return MAP_OUT_OF_MEMORY;
+
+    // compute value before binding becomes visible
+    if (fn)
+        fn (&b.value, 1, ctx);
+
+    // insert binding, appended to those held inline in small mode
+    write_begin (map);
+
+    if (is_small (map)) {
+        map->small[map->load] = b;
+        *added = &map->small[map->load];
+    } else {
+        *added = insert_binding (&map->table, &b);
+    }
+
+    write_end (map);
+
+    ++map->load;
+
+    return MAP_OK;
+
+}
+
+/* update key with given hash or create new binding if not exists */
+static int
+insert (hashmap *map, const void *key, uint64_t h, size_t len, Any value)
+{
+
+    size_t idx;
+
+    binding *b;
+    hashtable *t;
+
+    // update value of existing binding
+    if ((t = find (map, key, h, len, &idx))) {
+        write_begin (map);
+        slot_binding (t, idx)->value = value;
+        write_end (map);
+
+        return MAP_OK;
+    }
+
+    return add (map, key, h, len, value, NULL, NULL, &b);
+
+}
+
+/* index past the last binding of iterators */
+static inline size_t
+iter_end (const hashmap *map)
+{
+
+    if (is_small (map))
+        return map->load;
+
+    if (map->flags & MAP_COMPACT)
+        return map->table.entries;
+
+    return map->table.size + map->old.size;
+
+}
+
+/* index of first binding at or after given index, counting
+ * slots of old hashtable after those of hashtable, or
+ * of first entry not removed in compact mode */
+static size_t
+next_binding (const hashmap *map, size_t i)
+{
+
+    // bindings held inline are dense
+    if (is_small (map))
+        return i;
+
+    if (map->flags & MAP_COMPACT) {
+        for (; i < map->table.entries && map->table.bindings[i].len == ENTRY_REMOVED; ++i);
+
+        return i;
+    }
+
+    if (i < map->table.size && (i = ctrl_next_full (map->table.ctrl, map->table.size, i)) < map->table.size)
+        return i;
+
+    // go on in old hashtable during migration
+    return map->table.size + ctrl_next_full (map->old.ctrl, map->old.size, i - map->table.size);
+
+}
+
+
+/* allocate hashmap with table of given size */
+static int
+create (Hashmap *hm, int flags, HashFunc hash, uint64_t seed, size_t capacity)
+{
+
+    int ret;
+
+    hashmap *map;
+
+    // concurrent lookups must not migrate bindings
+    if ((flags & MAP_CONCURRENT_READS) && (flags & MAP_INCREMENTAL))
+        return MAP_INVALID_ARGUMENT;
+
+    // entries are kept in one array in insertion order and
+    // reallocated as they are appended, so neither may be
+    // spread over two hashtables nor read concurrently
+    if ((flags & MAP_COMPACT) && (flags & (MAP_INCREMENTAL | MAP_CONCURRENT_READS)))
+        return MAP_INVALID_ARGUMENT;
+
+    // robin hood runs are probed slot by slot, and
+    // only one sequence of groups can be probed
+    if ((flags & MAP_QUADRATIC) && (flags & (MAP_TRIANGULAR | MAP_ROBIN_HOOD)))
+        return MAP_INVALID_ARGUMENT;
+
+    if ((flags & MAP_TRIANGULAR) && (flags & MAP_ROBIN_HOOD))
+        return MAP_INVALID_ARGUMENT;
+
+    // inline storage only in small mode
+    map = malloc (sizeof (hashmap) + ((flags & MAP_SMALL) ? SMALL_SIZE * sizeof (binding) : 0));
+
+    if (!map)
+        return MAP_OUT_OF_MEMORY;
+
+    map->load = 0;
+    map->load_factor = DEFAULT_LOAD_FACTOR;
+    map->growth_rate = DEFAULT_GROWTH_RATE;
+    map->flags = flags;
+    map->hash = hash ? hash : (flags & MAP_SIPHASH) ? map_hash_siphash : DEFAULT_HASH;
+    map->seed = seed;
+    map->migrated = 0;
+    map->seq = 0;
+    map->retired = NULL;
+    map->image = NULL;
+    map->image_size = 0;
+
+#if defined(MAP_STATS)
+    map->resizes = 0;
+    map->resize_time = 0;
+#endif
+
+    map->table.flags = flags;
+    map->old.flags = flags;
+    map->old.size = 0;
+    map->old.deleted = 0;
+    map->old.base = 0;
+    map->old.ctrl = NULL;
+    map->old.bindings = NULL;
+    map->old.indices = NULL;
+    map->old.entries = 0;
+    map->old.capacity = 0;
+    map->keys.head = NULL;
+    map->keys.live = 0;
+    map->keys.dead = 0;
+    map->old_keys.head = NULL;
+    map->old_keys.live = 0;
+    map->old_keys.dead = 0;
+
+    // no table until bindings outgrow inline storage
+    if ((flags & MAP_SMALL) && capacity <= SMALL_SIZE) {
+        init_small (map);
+
+        *hm = map;
+
+        return MAP_OK;
+    }
+
+    ret = alloc_table (&map->table, capacity ? fitting_size (map, capacity) : next_size (&map->table, INITIAL_SIZE));
+
+    if (ret != MAP_OK) {
+        // free previously allocated resources
+        free (map);
+
+        return ret;
+    }
+
+    *hm = map;
+
+    return MAP_OK;
+
+}
+
+
+/* hash functions images refer to by index */
+static const HashFunc image_hashes[] = {
+    map_hash_djb2,
+    map_hash_wyhash,
+    map_hash_xxh64,
+    map_hash_siphash,
+};
+
+
+/* copy hashtable served from a mapped image into memory of
+ * the hashmap ahead of its first modification, keys are
+ * copied into an arena of the hashmap and owned from then on */
+static int
+thaw (hashmap *map)
+{
+
+    int ret;
+
+    size_t i;
+
+    binding *b;
+
+    hashtable fresh = map->table;
+
+    if (!map->image)
+        return MAP_OK;
+
+    ret = alloc_table (&fresh, map->table.size);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    memcpy (fresh.ctrl, map->table.ctrl, CTRL_SIZE (map->table.size));
+    fresh.deleted = map->table.deleted;
+
+    for (i = 0; i < fresh.size; ++i) {
+
+        if (fresh.ctrl[i] < 0)
+            continue;
+
+        b = &fresh.bindings[i];
+
+        *b = map->table.bindings[i];
+        b->key = arena_store (&map->keys, key_of (&map->table, b), b->len);
+
+        if (!b->key) {
+            // free previously allocated resources
+            arena_free (&map->keys);
+            free (fresh.ctrl);
+            free (fresh.bindings);
+
+            return MAP_OUT_OF_MEMORY;
+        }
+    }
+
+    munmap (map->image, map->image_size);
+
+    map->table = fresh;
+    map->image = NULL;
+    map->image_size = 0;
+    map->flags |= MAP_OWN_KEYS;
+
+    return MAP_OK;
+
+}
+
+
+/* initialize hashmap */
+int
+map_init (Hashmap *hm)
+{
+
+    return create (hm, 0, NULL, map_random_seed (), 0);
+
+}
+
+
+/* initialize hashmap with given mode flags */
+int
+map_init_with_flags (Hashmap *hm, int flags)
+{
+
+    return create (hm, flags, NULL, map_random_seed (), 0);
+
+}
+
+
+/* initialize hashmap with given mode flags and hash function */
+int
+map_init_with_hash (Hashmap *hm, int flags, HashFunc hash, uint64_t seed)
+{
+
+    return create (hm, flags, hash, seed, 0);
+
+}
+
+
+/* initialize hashmap with room for given count of bindings */
+int
+map_init_with_capacity (Hashmap *hm, size_t capacity)
+{
+
+    return create (hm, 0, NULL, map_random_seed (), capacity);
+
+}
+
+
+/* delete hashmap */
+int
+map_free (Hashmap hm)
+{
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    if (map->image)
+        munmap (map->image, map->image_size);
+    else if (!is_small (map))
+        free_table (&map->table);
+
+    free_table (&map->old);
+    arena_free (&map->keys);
+    arena_free (&map->old_keys);
+    reclaim (map);
+    free (map);
+
+    return MAP_OK;
+
+}
+
+
+/* retreive value of given key from hashmap */
+int
+map_lookup (Hashmap hm, Key key, Any *value)
+{
+
+    return map_lookup_n (hm, key, strlen (key), value);
+
+}
+
+
+/* retreive value of given key of given length from hashmap */
+int
+map_lookup_n (Hashmap hm, const void *key, size_t len, Any *value)
+{
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    return map_lookup_hashed (hm, key, len, hash (map, key, len), value);
+
+}
+
+
+/* retreive value of binary key of given length and hash */
+int
+map_lookup_hashed (Hashmap hm, const void *key, size_t len, uint64_t h, Any *value)
+{
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    migrate_step (map);
+
+    if (lookup (map, key, h, len, value) == MAP_OK)
+        return MAP_OK;
+
+    *value = NULL;
+
+    return MAP_KEY_NOT_FOUND;
+
+}
+
+
+/* retreive values of given keys from hashmap, hashing and prefetching
+ * the home slots of a batch of keys before probing any of them */
+int
+map_lookup_batch (Hashmap hm, const Key *keys, size_t n, Any *values, int *results)
+{
+
+    uint64_t h[LOOKUP_BATCH_SIZE];
+    size_t len[LOOKUP_BATCH_SIZE];
+
+    uint64_t seq;
+
+    size_t i, j, m, idx;
+
+    hashtable t;
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    migrate_step (map);
+
+    for (i = 0; i < n; i += m) {
+
+        m = n - i < LOOKUP_BATCH_SIZE ? n - i : LOOKUP_BATCH_SIZE;
+
+        // consistent snapshot of hashtable against a concurrent writer,
+        // prefetches from a table replaced since are merely wasted
+        do {
+            seq = read_begin (map);
+            t = map->table;
+        } while ((map->flags & MAP_CONCURRENT_READS) && read_retry (map, seq));
+
+        // hash batch and request home slots, misses overlap
+        for (j = 0; j < m; ++j) {
+
+            len[j] = strlen (keys[i + j]);
+            h[j] = hash (map, keys[i + j], len[j]);
+
+            // bindings held inline have no home slots
+            if (!t.size)
+                continue;
+
+            idx = home (&t, h[j]);
+
+            PREFETCH (t.ctrl + idx);
+
+            if (t.flags & MAP_COMPACT)
+                PREFETCH (t.indices + idx);
+            else
+                PREFETCH (t.bindings + idx);
+
+        }
+
+        // probe batch
+        for (j = 0; j < m; ++j) {
+
+            results[i + j] = lookup (map, keys[i + j], h[j], len[j], &values[i + j]);
+
+            if (results[i + j] != MAP_OK)
+                values[i + j] = NULL;
+
+        }
+    }
+
+    return MAP_OK;
+
+}
+
+
+/* update key or create new binding if not exists */
+int
+map_insert (Hashmap hm, Key key, Any value)
+{
+
+    return map_insert_n (hm, key, strlen (key), value);
+
+}
+
+
+/* update key of given length or create new binding if not exists */
+int
+map_insert_n (Hashmap hm, const void *key, size_t len, Any value)
+{
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    return map_insert_hashed (hm, key, len, hash (map, key, len), value);
+
+}
+
+
+/* update binary key of given length and hash or create new binding if not exists */
+int
+map_insert_hashed (Hashmap hm, const void *key, size_t len, uint64_t h, Any value)
+{
+
+    int ret;
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    ret = thaw (map);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    ret = migrate_step (map);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    return insert (map, key, h, len, value);
+
+}
+
+
+/* retreive pointer to value of key, creating binding if not exists */
+int
+map_entry (Hashmap hm, Key key, Any **value, int *inserted)
+{
+
+    return map_entry_n (hm, key, strlen (key), value, inserted);
+
+}
+
+
+/* retreive pointer to value of key of given
+ * length, creating binding if not exists */
+int
+map_entry_n (Hashmap hm, const void *key, size_t len, Any **value, int *inserted)
+{
+
+    int ret;
+
+    size_t idx;
+    uint64_t h;
+
+    binding *b;
+    hashtable *t;
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    // writes through pointer would race with concurrent lookups
+    if (map->flags & MAP_CONCURRENT_READS)
+        return MAP_INVALID_ARGUMENT;
+
+    ret = thaw (map);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    ret = migrate_step (map);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    h = hash (map, key, len);
+
+    // existing binding
+    if ((t = find (map, key, h, len, &idx))) {
+        *value = &slot_binding (t, idx)->value;
+        *inserted = 0;
+
+        return MAP_OK;
+    }
+
+    ret = add (map, key, h, len, NULL, NULL, NULL, &b);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    *value = &b->value;
+    *inserted = 1;
+
+    return MAP_OK;
+
+}
+
+
+/* apply function to value of key, creating binding if not exists */
+int
+map_upsert (Hashmap hm, Key key, UpsertFunc fn, void *ctx)
+{
+
+    return map_upsert_n (hm, key, strlen (key), fn, ctx);
+
+}
+
+
+/* apply function to value of key of given length,
+ * creating binding if not exists */
+int
+map_upsert_n (Hashmap hm, const void *key, size_t len, UpsertFunc fn, void *ctx)
+{
+
+    int ret;
+
+    size_t idx;
+    uint64_t h;
+
+    binding *b;
+    hashtable *t;
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    if (!fn)
+        return MAP_INVALID_ARGUMENT;
+
+    ret = thaw (map);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    ret = migrate_step (map);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    h = hash (map, key, len);
+
+    // update value of existing binding in place
+    if ((t = find (map, key, h, len, &idx))) {
+        write_begin (map);
+        fn (&slot_binding (t, idx)->value, 0, ctx);
+        write_end (map);
+
+        return MAP_OK;
+    }
+
+    return add (map, key, h, len, NULL, fn, ctx, &b);
+
+}
+
+
+/* hash chunk of keys of bulk insertion and
+ * count them by region of their home slot */
+static void *
+bulk_hash (void *arg)
+{
+
+    size_t i;
+
+    bulk_worker *w = arg;
+
+    const bulk *b = w->shared;
+
+    for (i = w->begin; i < w->end; ++i) {
+
+        b->lens[i] = strlen (b->keys[i]);
+        b->hashes[i] = hash (b->map, b->keys[i], b->lens[i]);
+
+        if (w->offsets)
+            ++w->offsets[home (&b->map->table, b->hashes[i]) / b->width];
+
+    }
+
+    return NULL;
+
+}
+
+/* order chunk of keys of bulk insertion by region of their home slot */
+static void *
+bulk_order (void *arg)
+{
+
+    size_t i;
+
+    bulk_worker *w = arg;
+
+    const bulk *b = w->shared;
+
+    for (i = w->begin; i < w->end; ++i)
+        b->order[w->offsets[home (&b->map->table, b->hashes[i]) / b->width]++] = i;
+
+    return NULL;
+
+}
+
+/* insert keys of bulk insertion whose probe sequence stays within the
+ * region of the worker, and so touches no slot of any other worker */
+static void *
+bulk_fill (void *arg)
+{
+
+    int ret;
+
+    size_t i, j, idx, lo, hi;
+
+    binding e;
+
+    bulk_worker *w = arg;
+
+    const bulk *b = w->shared;
+
+    hashtable *t = &b->map->table;
+
+    // region of slots was handed over in place of the chunk of keys
+    lo = w->begin;
+    hi = w->end;
+
+    for (j = w->first; j < w->last; ++j) {
+
+        i = b->order[j];
+
+        ret = find_in_region (t, b->keys[i], b->hashes[i], b->lens[i], lo, hi, &idx);
+
+        // left for insertion after all workers
+        if (ret == MAP_PROBING_FAILED) {
+            b->order[w->first + w->deferred++] = i;
+
+            continue;
+        }
+
+        // update value of existing binding
+        if (ret == MAP_OK) {
+            slot_binding (t, idx)->value = b->values[i];
+
+            continue;
+        }
+
+        e.key = b->keys[i];
+        e.value = b->values[i];
+        e.hash = b->hashes[i];
+        e.len = b->lens[i];
+
+        // take ownership of a copy of key
+        if ((b->map->flags & MAP_OWN_KEYS) && !(e.key = arena_store (&w->keys, e.key, e.len))) {
+            w->ret = MAP_OUT_OF_MEMORY;
+
+            break;
+        }
+
+        // reuse deleted slot
+        w->reused += ctrl_claim (t->ctrl, t->size, idx, CTRL_TAG (e.hash));
+
+        set_binding (t, idx, &e);
+
+        ++w->inserted;
+
+    }
+
+    return NULL;
+
+}
+
+/* run function on every worker of given size in a thread of its own, and
+ * in the calling thread for the first worker and any thread failing to start */
+static void
+run_workers (void *workers, size_t size, size_t count, void *(*fn) (void *))
+{
+
+    size_t i;
+
+    worker_thread *w;
+
+    for (i = 1; i < count; ++i) {
+        w = (worker_thread *) ((char *) workers + i * size);
+        w->started = !pthread_create (&w->thread, NULL, fn, w);
+    }
+
+    fn (workers);
+
+    for (i = 1; i < count; ++i) {
+        w = (worker_thread *) ((char *) workers + i * size);
+
+        if (w->started)
+            pthread_join (w->thread, NULL);
+        else
+            fn (w);
+
+    }
+
+}
+
+
+/* insert many bindings at once, sizing the table upfront and hashing
+ * keys and filling disjoint regions of the table in worker threads */
+int
+map_insert_bulk (Hashmap hm, const Key *keys, const Any *values, size_t n, size_t nthreads)
+{
+
+    int ret, fill;
+
+    size_t i, j, r, size, offset, count;
+
+    bulk b;
+    bulk_worker *workers;
+    size_t *offsets = NULL;
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    if (!nthreads)
+        return MAP_INVALID_ARGUMENT;
+
+    if (!n)
+        return MAP_OK;
+
+    ret = thaw (map);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    // finish pending migration, workers fill a single hashtable
+    ret = migrate (map, SIZE_MAX);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    size = fitting_size (map, map->load + n);
+
+    if (size < map->table.size)
+        size = map->table.size;
+
+    // make room for all keys at once, purging deleted slots if need
+    // be, unless they all fit into inline storage in small mode
+    if (is_small (map) ? map->load + n > SMALL_SIZE
+        : size > map->table.size || map->load + map->table.deleted + n >= map->load_factor * size) {
+        ret = resize (map, size);
+
+        if (ret != MAP_OK)
+            return ret;
+    }
+
+    // regions of few slots would leave most keys for after the workers
+    if (nthreads > map->table.size / BULK_MIN_REGION)
+        nthreads = map->table.size / BULK_MIN_REGION ? map->table.size / BULK_MIN_REGION : 1;
+
+    b.map = map;
+    b.keys = keys;
+    b.values = values;
+    b.width = (map->table.size + nthreads - 1) / nthreads;
+    b.hashes = malloc (n * sizeof (uint64_t));
+    b.lens = malloc (n * sizeof (size_t));
+    b.order = malloc (n * sizeof (size_t));
+
+    workers = calloc (nthreads, sizeof (bulk_worker));
+
+    // robin hood insertion shifts bindings and compact mode appends
+    // entries in order, fill regions only if neither is the case
+    fill = nthreads > 1 && !(map->flags & (MAP_ROBIN_HOOD | MAP_COMPACT));
+
+    if (fill)
+        offsets = calloc (nthreads * nthreads, sizeof (size_t));
+
+    ret = MAP_OUT_OF_MEMORY;
+
+    if (!b.hashes || !b.lens || !b.order || !workers || (fill && !offsets))
+        goto DONE;
+
+    for (i = 0; i < nthreads; ++i) {
+        workers[i].shared = &b;
+        workers[i].begin = n / nthreads * i;
+        workers[i].end = i == nthreads - 1 ? n : n / nthreads * (i + 1);
+        workers[i].offsets = offsets ? offsets + i * nthreads : NULL;
+        workers[i].ret = MAP_OK;
+    }
+
+    run_workers (workers, sizeof (bulk_worker), nthreads, bulk_hash);
+
+    if (fill) {
+
+        // turn counts into offsets, keys of each region
+        // ordered by worker that hashed them
+        for (r = 0, offset = 0; r < nthreads; ++r) {
+
+            workers[r].first = offset;
+
+            for (i = 0; i < nthreads; ++i) {
+                count = offsets[i * nthreads + r];
+                offsets[i * nthreads + r] = offset;
+                offset += count;
+            }
+
+            workers[r].last = offset;
+        }
+
+        run_workers (workers, sizeof (bulk_worker), nthreads, bulk_order);
+
+        // workers now fill a region of slots each
+        for (r = 0; r < nthreads; ++r) {
+            workers[r].begin = b.width * r;
+            workers[r].end = b.width * (r + 1) < map->table.size ? b.width * (r + 1) : map->table.size;
+        }
+
+        write_begin (map);
+        run_workers (workers, sizeof (bulk_worker), nthreads, bulk_fill);
+        write_end (map);
+
+        ret = MAP_OK;
+
+        for (r = 0; r < nthreads; ++r) {
+
+            map->load += workers[r].inserted;
+            map->table.deleted -= workers[r].reused;
+
+            arena_merge (&map->keys, &workers[r].keys);
+
+            if (workers[r].ret != MAP_OK)
+                ret = workers[r].ret;
+
+        }
+
+        // insert keys whose probe sequence left the region of their worker
+        for (r = 0; r < nthreads && ret == MAP_OK; ++r) {
+
+            for (j = workers[r].first; j < workers[r].first + workers[r].deferred && ret == MAP_OK; ++j) {
+                i = b.order[j];
+                ret = insert (map, keys[i], b.hashes[i], b.lens[i], values[i]);
+            }
+        }
+    } else {
+        ret = MAP_OK;
+
+        // insert keys in order
+        for (i = 0; i < n && ret == MAP_OK; ++i)
+            ret = insert (map, keys[i], b.hashes[i], b.lens[i], values[i]);
+    }
+
+DONE:
+    // free resources
+    free (b.hashes);
+    free (b.lens);
+    free (b.order);
+    free (offsets);
+    free (workers);
+
+    return ret;
+
+}
+
+
+/* remove binding from hashmap */
+int
+map_remove (Hashmap hm, Key key)
+{
+
+    return map_remove_n (hm, key, strlen (key));
+
+}
+
+
+/* remove binding with key of given length from hashmap */
+int
+map_remove_n (Hashmap hm, const void *key, size_t len)
+{
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    return map_remove_hashed (hm, key, len, hash (map, key, len), NULL);
+
+}
+
+
+/* remove binding with binary key of given length and hash from hashmap,
+ * retreiving its value unless null */
+int
+map_remove_hashed (Hashmap hm, const void *key, size_t len, uint64_t h, Any *value)
+{
+
+    int ret;
+
+    size_t idx;
+
+    hashtable *t;
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    ret = thaw (map);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    migrate_step (map);
+
+    if (!(t = find (map, key, h, len, &idx)))
+        return MAP_KEY_NOT_FOUND;
+
+    if (value)
+        *value = slot_binding (t, idx)->value;
+
+    write_begin (map);
+
+    // entry is left behind in compact mode and counted as deleted
+    // until rehashing drops it, which keeps the insertion order
+    if (t->flags & MAP_COMPACT) {
+        slot_binding (t, idx)->len = ENTRY_REMOVED;
+        ++t->deleted;
+    }
+
+    // bindings held inline close the gap to keep insertion
+    // order, old hashtable is drained in slot order, never shift it
+    if (is_small (map))
+        memmove (&map->small[idx], &map->small[idx + 1], (map->load - idx - 1) * sizeof (binding));
+    else if (t == &map->table && (map->flags & MAP_ROBIN_HOOD))
+        remove_backward_shift (t, idx);
+    else
+        remove_linear (t, idx);
+
+    write_end (map);
+
+    --map->load;
+
+    // key of binding is left behind in its arena
+    if (map->flags & MAP_OWN_KEYS) {
+        arena_release (t == &map->old ? &map->old_keys : &map->keys, len);
+        purge_keys (map);
+    }
+
+    return MAP_OK;
+
+}
+
+
+/* test if hashmap contains binding with given key */
+int
+map_contains (const Hashmap hm, const Key key)
+{
+
+    return map_contains_n (hm, key, strlen (key));
+
+}
+
+
+/* test if hashmap contains binding with given key of given length */
+int
+map_contains_n (const Hashmap hm, const void *key, size_t len)
+{
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    return map_contains_hashed (hm, key, len, hash (map, key, len));
+
+}
+
+
+/* test if hashmap contains binding with binary key of given length and hash */
+int
+map_contains_hashed (const Hashmap hm, const void *key, size_t len, uint64_t h)
+{
+
+    Any value;
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    migrate_step (map);
+
+    return lookup (map, key, h, len, &value);
+
+}
+
+
+/* retreive current count of bindings from hashmap */
+int
+map_count (Hashmap hm, size_t *count)
+{
+
+    hashmap *map = hm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    *count = map->load;
+
+    return MAP_OK;
+
+}
+
+
+/* add bindings of hashtable by groups probed to find them and
+ * the longest run of slots without an empty one to statistics */
+static void
+table_stats (const hashtable *t, MapStats *stats)
+{
+
+    size_t i, start, run, groups;
+
+    probe p;
+
+    for (i = 0; i < t->size; ++i) {
+
+        if (t->ctrl[i] < 0)
+            continue;
+
+        if (!(t->flags & (MAP_QUADRATIC | MAP_TRIANGULAR)))
+            groups = distance (t, i) / GROUP_WIDTH;
+        else
+            // follow probe sequence to group holding slot
+            for (probe_init (t, slot_binding (t, i)->hash, &p), groups = 0;
+                 (i + t->size - p.idx) % t->size >= GROUP_WIDTH && probe_next (t, &p); ++groups);
+
+        if (groups >= MAP_STATS_PROBE_LENGTHS)
+            groups = MAP_STATS_PROBE_LENGTHS - 1;
+
+        ++stats->probe_lengths[groups];
+
+    }
+
+    // start after an empty slot so that no run wraps around
+    for (start = 0; start < t->size && t->ctrl[start] != CTRL_EMPTY; ++start);
+
+    if (start == t->size) {
+        if (t->size > stats->max_run)
+            stats->max_run = t->size;
+
+        return;
+    }
+
+    for (i = 1, run = 0; i <= t->size; ++i) {
+
+        if (t->ctrl[(start + i) % t->size] == CTRL_EMPTY)
+            run = 0;
+        else if (++run > stats->max_run)
+            stats->max_run = run;
+
+    }
+
+}
+
+
+/* retreive statistics of hashmap */
+int
+map_stats (const Hashmap hm, MapStats *stats)
 {
 
-    for (;; ++n) {
+    hashmap *map = hm;
 
-        if (n % 2 == 0 || n % 3 == 0)
-            goto NEXT;
+    if (!map)
+        return MAP_INVALID;
 
-        size_t div = 6;
-        while (div * div - (div << 1) + 1 <= n) {
-            if (n % (div - 1) == 0 || n % (div + 1) == 0)
-                goto NEXT;
+    memset (stats, 0, sizeof (MapStats));
 
-            div += 6;
-        }
+    stats->size = map->table.size;
+    stats->load = map->load;
+    stats->deleted = map->table.deleted + map->old.deleted;
 
-        return n;
+    table_stats (&map->table, stats);
+    table_stats (&map->old, stats);
 
-NEXT:
-        continue;
+    // bindings held inline are found by a single scan
+    if (is_small (map))
+        stats->probe_lengths[0] = map->load;
+
+#if defined(MAP_STATS)
+    stats->resizes = map->resizes;
+    stats->resize_time = map->resize_time;
+#endif
+
+    return MAP_OK;
 
-    }
 }
 
-/* find empty slot */
-static int
-find_slot (hashmap *map, Key key, size_t *index)
+
+/* make room for given count of bindings without further resizes */
+int
+map_reserve (Hashmap hm, size_t count)
 {
 
-    size_t i, idx;
+    int ret;
 
-    // get slot index for key
-    idx = hash (key) % map->size;
+    size_t size;
+
+    hashmap *map = hm;
 
-    // linear probing
-    for (i = 0; i < LINEAR_PROBING_MAX_SEQUENCE; ++i) {
+    if (!map)
+        return MAP_INVALID;
 
-        // slot at index has no binding or keys match
-        if (!map->table[idx].key || strcmp (map->table[idx].key, key) == 0) {
-            // retreive index
-            *index = idx;
+    size = fitting_size (map, count);
 
-            return MAP_OK;
-        }
+    if (size <= map->table.size || (is_small (map) && count <= SMALL_SIZE))
+        return MAP_OK;
 
-        idx = (idx + LINEAR_PROBING_INTERVAL) % map->size;
+    ret = thaw (map);
 
-    }
+    if (ret != MAP_OK)
+        return ret;
 
-    return MAP_PROBING_FAILED;
+    return grow (map, size);
 
 }
 
-/* grow table and rehash all keys */
-static int
-resize (hashmap *map)
+
+/* shrink table to smallest size holding current bindings */
+int
+map_shrink_to_fit (Hashmap hm)
 {
 
     int ret;
 
-    size_t i, idx;
-
-    size_t old_size;
-    binding *old_table;
-
-    // backup old table
-    old_size = map->size;
-    old_table = map->table;
+    size_t size;
 
-    // grow by given factor then round up to next prime
-    map->size = next_prime (GROWTH_RATE * old_size);
-    // allocate new table
-    map->table = calloc (map->size, sizeof (binding));
+    hashmap *map = hm;
 
-    if (!map->table) {
-        // restore
-        map->table = old_table;
-        map->size = old_size;
+    if (!map)
+        return MAP_INVALID;
 
-        return MAP_OUT_OF_MEMORY;
-    }
+    ret = thaw (map);
 
-    // rehash
-    for (i = 0; i < old_size; ++i) {
+    if (ret != MAP_OK)
+        return ret;
 
-        // slot at index has binding
-        if (old_table[i].key) {
-            // get slot index for key
-            ret = find_slot (map, old_table[i].key, &idx);
+    // finish pending migration
+    ret = migrate (map, SIZE_MAX);
 
-            if (!ret) {
-                // free previously allocated resources
-                free (map->table);
+    if (ret != MAP_OK)
+        return ret;
 
-                // restore
-                map->table = old_table;
-                map->size = old_size;
+    if (is_small (map))
+        return MAP_OK;
 
-                return MAP_PROBING_FAILED;
-            }
+    // few enough bindings to be held inline again
+    if ((map->flags & MAP_SMALL) && map->load <= SMALL_SIZE)
+        return rehash_small (map);
 
-            // insert binding
-            map->table[idx].key = old_table[i].key;
-            map->table[idx].value = old_table[i].value;
-        }
-    }
+    size = fitting_size (map, map->load);
 
-    free (old_table);
+    if (size >= map->table.size && !map->table.deleted)
+        return MAP_OK;
 
-    return MAP_OK;
+    // purge deleted slots at current size unless a smaller size fits
+    return resize (map, size < map->table.size ? size : map->table.size);
 
 }
 
 
-/* initialize hashmap */
+/* remove all bindings while keeping table size */
 int
-map_init (Hashmap *hm)
+map_clear (Hashmap hm)
 {
 
-    hashmap *map = malloc (sizeof (hashmap));
+    int ret;
+
+    retired *r;
+
+    hashmap *map = hm;
 
     if (!map)
-        return MAP_OUT_OF_MEMORY;
+        return MAP_INVALID;
 
-    map->table = calloc (INITIAL_SIZE,  sizeof (binding));
+    ret = thaw (map);
 
-    if (!map->table) {
-        // free previously allocated resources
-        free (map);
+    if (ret != MAP_OK)
+        return ret;
 
-        return MAP_OUT_OF_MEMORY;
+    // concurrent lookups may still compare keys, retire whole arena
+    if ((map->flags & MAP_CONCURRENT_READS) && map->keys.head) {
+
+        if (!(r = calloc (1, sizeof (retired))))
+            return MAP_OUT_OF_MEMORY;
+
+        r->chunks = map->keys.head;
+        r->next = map->retired;
+
+        map->retired = r;
+        map->keys.head = NULL;
     }
 
-    map->size = INITIAL_SIZE;
+    free_table (&map->old);
+
+    write_begin (map);
+
+    // bindings held inline are cut off by their count alone
+    if (!is_small (map))
+        ctrl_clear (map->table.ctrl, map->table.size);
+
     map->load = 0;
 
-    *hm = map;
+    write_end (map);
+
+    arena_free (&map->old_keys);
+    arena_clear (&map->keys);
+
+    map->table.deleted = 0;
+    map->table.entries = 0;
+    map->migrated = 0;
 
     return MAP_OK;
 
 }
 
 
-/* delete hashmap */
+/* set ratio of bindings to table size triggering a resize */
 int
-map_free (Hashmap hm)
+map_set_load_factor (Hashmap hm, double load_factor)
 {
 
     hashmap *map = hm;
@@ -256,206 +3430,283 @@ map_free (Hashmap hm)
     if (!map)
         return MAP_INVALID;
 
-    free (map->table);
-    free (map);
+    // keep at least one free slot for probing to terminate
+    if (!(load_factor > 0 && load_factor < 1))
+        return MAP_INVALID_ARGUMENT;
+
+    map->load_factor = load_factor;
 
     return MAP_OK;
 
 }
 
 
-/* retreive value of given key from hashmap */
+/* set factor by which the table size grows */
 int
-map_lookup (Hashmap hm, Key key, Any *value)
+map_set_growth_rate (Hashmap hm, double growth_rate)
 {
 
-    size_t i, idx;
-
     hashmap *map = hm;
 
     if (!map)
         return MAP_INVALID;
 
-    // get slot index for key
-    idx = hash (key) % map->size;
+    if (!(growth_rate > 1))
+        return MAP_INVALID_ARGUMENT;
 
-    // linear probing
-    for (i = 0; i < LINEAR_PROBING_MAX_SEQUENCE; ++i) {
+    map->growth_rate = growth_rate;
 
-        // slot at index has no binding
-        if (!map->table[idx].key)
-            break;
+    return MAP_OK;
 
-        // slot at index has binding and keys match
-        if (strcmp (map->table[idx].key, key) == 0) {
-            // retreive value
-            *value = map->table[idx].value;
+}
 
-            return MAP_OK;
-        }
 
-        idx = (idx + LINEAR_PROBING_INTERVAL) % map->size;
-    }
+/* free hashtables and keys retired by the writer */
+int
+map_reclaim (Hashmap hm)
+{
 
-    *value = NULL;
+    hashmap *map = hm;
 
-    return MAP_KEY_NOT_FOUND;
+    if (!map)
+        return MAP_INVALID;
+
+    reclaim (map);
+
+    return MAP_OK;
 
 }
 
 
-/* update key or create new binding if not exists */
+/* write position independent image of hashmap to file at given path */
 int
-map_insert (Hashmap hm, Key key, Any value)
+map_save (Hashmap hm, const char *path)
 {
 
     int ret;
 
-    size_t idx;
+    size_t i, h, words;
+
+    uint64_t offset;
+
+    FILE *f;
+
+    binding b;
+    image_header header;
+
+    hashtable *t;
+    hashtable slots;
 
     hashmap *map = hm;
 
+    static const char padding[IMAGE_ALIGN];
+
     if (!map)
         return MAP_INVALID;
 
-    // load factor exceeds threshold
-    if ((float) map->load / (float) map->size >= LOAD_FACTOR_THRESHOLD) {
-        // grow table and rehash
-        ret = resize (map);
+    // images refer to hash function by index
+    for (h = 0; h < sizeof (image_hashes) / sizeof (*image_hashes) && image_hashes[h] != map->hash; ++h);
 
-        if (!ret)
-            return ret;
-    }
+    if (h == sizeof (image_hashes) / sizeof (*image_hashes))
+        return MAP_INVALID_ARGUMENT;
 
-    // get slot index for key
-    ret = find_slot (map, key, &idx);
+    // finish pending migration
+    ret = migrate (map, SIZE_MAX);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    t = &map->table;
 
-    // no slot found
-    if (!ret) {
-        // make one attempt to resolve collision chain
-        ret = resize (map);
+    // images have slots, lay bindings held inline out in a hashtable of their own
+    if (is_small (map)) {
+        slots.flags = map->flags & ~MAP_COMPACT;
 
-        if (!ret)
+        ret = alloc_table (&slots, fitting_size (map, map->load));
+
+        if (ret != MAP_OK)
             return ret;
 
-        // and try again
-        ret = find_slot (map, key, &idx);
+        for (i = 0; i < map->load; ++i)
+            insert_binding (&slots, &map->small[i]);
 
-        // give up if again no slot was found
-        if (!ret)
-            return MAP_PROBING_FAILED;
+        t = &slots;
     }
 
-    // insert binding
-    map->table[idx].key = key;
-    map->table[idx].value = value;
+    memset (&header, 0, sizeof (image_header));
+    memcpy (header.magic, IMAGE_MAGIC, sizeof (header.magic));
+
+    header.word_size = sizeof (size_t);
+    header.binding_size = sizeof (binding);
+    header.flags = map->flags & (MAP_ROBIN_HOOD | MAP_POW2 | MAP_FIBONACCI | MAP_QUADRATIC | MAP_TRIANGULAR);
+    header.hash = h;
+    header.seed = map->seed;
+    header.size = t->size;
+    header.deleted = t->deleted;
+    header.load = map->load;
+    header.load_factor = map->load_factor;
+    header.growth_rate = map->growth_rate;
+    header.ctrl = IMAGE_ALIGN_UP (sizeof (image_header));
+    header.bindings = IMAGE_ALIGN_UP (header.ctrl + CTRL_SIZE (t->size));
+    header.keys = IMAGE_ALIGN_UP (header.bindings + t->size * sizeof (binding));
+    header.length = header.keys;
+
+    // compact tables count removed entries, images count deleted slots
+    if (t->flags & MAP_COMPACT)
+        header.deleted = 0;
+
+    // keys laid out like in an arena
+    for (i = 0; i < t->size; ++i) {
+
+        if (t->ctrl[i] >= 0)
+            header.length += (1 + (slot_binding (t, i)->len + sizeof (size_t)) / sizeof (size_t)) * sizeof (size_t);
+        else if (t->ctrl[i] == CTRL_DELETED && (t->flags & MAP_COMPACT))
+            ++header.deleted;
 
-    ++map->load;
+    }
 
-    return MAP_OK;
+    f = fopen (path, "wb");
 
-}
+    if (!f) {
+        // free previously allocated resources
+        if (t == &slots)
+            free_table (&slots);
 
+        return MAP_IO_ERROR;
+    }
 
-/* remove binding from hashmap */
-int
-map_remove (Hashmap hm, Key key)
-{
+    fwrite (&header, sizeof (image_header), 1, f);
+    fwrite (padding, header.ctrl - sizeof (image_header), 1, f);
 
-    size_t i, idx, removed_idx, last_idx;
+    fwrite (t->ctrl, CTRL_SIZE (t->size), 1, f);
+    fwrite (padding, header.bindings - header.ctrl - t->size - GROUP_WIDTH + 1, 1, f);
 
-    hashmap *map = hm;
+    // bindings refer to keys by offset
+    for (i = 0, offset = header.keys; i < t->size; ++i) {
 
-    if (!map)
-        return MAP_INVALID;
+        memset (&b, 0, sizeof (binding));
 
-    // get slot index for key
-    idx = hash (key) % map->size;
+        if (t->ctrl[i] >= 0) {
+            b = *slot_binding (t, i);
+            b.key = (Key) (uintptr_t) (offset + sizeof (size_t));
 
-    // linear probing
-    for (i = 0; i < LINEAR_PROBING_MAX_SEQUENCE; ++i) {
+            offset += (1 + (b.len + sizeof (size_t)) / sizeof (size_t)) * sizeof (size_t);
+        }
 
-        // slot at index has no binding
-        if (!map->table[idx].key)
-            return MAP_KEY_NOT_FOUND;
+        fwrite (&b, sizeof (binding), 1, f);
 
-        // slot at index has binding and keys match
-        if (strcmp (map->table[idx].key, key) == 0) {
-            // mark for deletion
-            removed_idx = idx;
-            // skip to end of collision chain
-            for (; map->table[idx].key; idx = (idx + LINEAR_PROBING_INTERVAL) % map->size);
-            // get last binding for relocation
-            last_idx = (idx - LINEAR_PROBING_INTERVAL) % map->size;
-
-            // relocate
-            if (last_idx != removed_idx) {
-                map->table[removed_idx].key = map->table[last_idx].key;
-                map->table[removed_idx].value = map->table[last_idx].value;
-            }
+    }
 
-            // remove
-            map->table[last_idx].key = NULL;
-            map->table[last_idx].value = NULL;
+    fwrite (padding, header.keys - header.bindings - t->size * sizeof (binding), 1, f);
 
-            --map->load;
+    for (i = 0; i < t->size; ++i) {
 
-            return MAP_OK;
-        }
+        if (t->ctrl[i] < 0)
+            continue;
 
-        idx = (idx + LINEAR_PROBING_INTERVAL) % map->size;
+        b = *slot_binding (t, i);
+        words = 1 + (b.len + sizeof (size_t)) / sizeof (size_t);
+
+        // prefix length, pad with NUL to whole words
+        fwrite (&b.len, sizeof (size_t), 1, f);
+        fwrite (key_of (t, &b), b.len, 1, f);
+        fwrite (padding, (words - 1) * sizeof (size_t) - b.len, 1, f);
 
     }
 
-    return MAP_PROBING_FAILED;
+    ret = ferror (f) ? MAP_IO_ERROR : MAP_OK;
+
+    if (fclose (f) && ret == MAP_OK)
+        ret = MAP_IO_ERROR;
+
+    if (t == &slots)
+        free_table (&slots);
+
+    return ret;
+
 }
 
 
-/* test if hashmap contains binding with given key */
+/* open hashmap served from image file at given path without
+ * reading it in, copied into memory on first modification */
 int
-map_contains (const Hashmap hm, const Key key)
+map_open_mmap (Hashmap *hm, const char *path)
 {
 
-    size_t i, idx;
+    int fd, ret;
 
-    hashmap *map = hm;
+    void *image;
 
-    if (!map)
-        return MAP_INVALID;
+    struct stat st;
 
-    // get slot index for key
-    idx = hash (key) % map->size;
+    const image_header *header;
 
-    // linear probing
-    for (i = 0; i < LINEAR_PROBING_MAX_SEQUENCE; ++i) {
+    hashmap *map;
 
-        // slot at index has no binding
-        if (!map->table[idx].key)
-            break;
+    fd = open (path, O_RDONLY);
 
-        // slot at index has binding and keys match
-        if (strcmp (map->table[idx].key, key) == 0)
-            return MAP_OK;
+    if (fd < 0)
+        return MAP_IO_ERROR;
 
-        idx = (idx + LINEAR_PROBING_INTERVAL) % map->size;
+    if (fstat (fd, &st) || st.st_size < (off_t) sizeof (image_header)) {
+        close (fd);
+
+        return MAP_INVALID_IMAGE;
     }
 
-    return MAP_KEY_NOT_FOUND;
+    image = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
 
-}
+    close (fd);
 
+    if (image == MAP_FAILED)
+        return MAP_IO_ERROR;
 
-/* retreive current count of bindings from hashmap */
-int
-map_count (Hashmap hm, size_t *count)
-{
+    header = image;
 
-    hashmap *map = hm;
+    // image must have been written with the same layout and be complete
+    if (memcmp (header->magic, IMAGE_MAGIC, sizeof (header->magic))
+        || header->word_size != sizeof (size_t)
+        || header->binding_size != sizeof (binding)
+        || header->hash >= sizeof (image_hashes) / sizeof (*image_hashes)
+        || header->length != (uint64_t) st.st_size
+        || header->size < GROUP_WIDTH || header->size > header->length
+        || header->load > header->size
+        || ((header->flags & (MAP_POW2 | MAP_FIBONACCI)) && (header->size & (header->size - 1)))
+        || header->ctrl < sizeof (image_header)
+        || header->bindings < header->ctrl + CTRL_SIZE (header->size)
+        || header->keys < header->bindings + header->size * sizeof (binding)
+        || header->keys > header->length) {
+        munmap (image, st.st_size);
 
-    if (!map)
-        return MAP_INVALID;
+        return MAP_INVALID_IMAGE;
+    }
 
-    *count = map->load;
+    ret = create (hm, header->flags, image_hashes[header->hash], header->seed, 0);
+
+    if (ret != MAP_OK) {
+        munmap (image, st.st_size);
+
+        return ret;
+    }
+
+    map = *hm;
+
+    // serve hashtable from image
+    free_table (&map->table);
+
+    map->table.size = header->size;
+    map->table.deleted = header->deleted;
+    map->table.base = (uintptr_t) image;
+    map->table.shift = table_shift (header->size);
+    map->table.reciprocal = UINT64_MAX / header->size;
+    map->table.ctrl = (int8_t *) image + header->ctrl;
+    map->table.bindings = (binding *) ((char *) image + header->bindings);
+
+    map->load = header->load;
+    map->load_factor = header->load_factor;
+    map->growth_rate = header->growth_rate;
+    map->image = image;
+    map->image_size = st.st_size;
 
     return MAP_OK;
 
@@ -467,7 +3718,7 @@ int
 map_iter_init (Iterator *it, const Hashmap hm)
 {
 
-    size_t i;
+    int ret;
 
     hashmap_iterator *iter;
 
@@ -476,6 +3727,12 @@ map_iter_init (Iterator *it, const Hashmap hm)
     if (!map)
         return MAP_INVALID;
 
+    // finish pending migration, which would move bindings past the iterator
+    ret = map->flags & MAP_INCREMENTAL ? migrate (map, SIZE_MAX) : MAP_OK;
+
+    if (ret != MAP_OK)
+        return ret;
+
     iter = malloc (sizeof (hashmap_iterator));
 
     if (!iter)
@@ -485,14 +3742,8 @@ map_iter_init (Iterator *it, const Hashmap hm)
     iter->map = map;
 
     // point iterator to first binding
-    for (i = 0; i <= map->size; ++i) {
-
-        iter->next = i;
-
-        // slot at index has binding or iterator is exhausted
-        if (i == map->size || map->table[i].key)
-            break;
-    }
+    iter->next = next_binding (map, 0);
+    iter->end = SIZE_MAX;
 
     *it = iter;
 
@@ -527,7 +3778,7 @@ map_iter_has_next (const Iterator it)
     if (!iter)
         return MAP_INVALID;
 
-    if (iter->next == iter->map->size)
+    if (iter->next >= iter_end (iter->map) || iter->next >= iter->end)
         return MAP_ITERATOR_EXHAUSTED;
 
     return MAP_OK;
@@ -540,34 +3791,68 @@ int
 map_iter_next (Iterator it, Key *key, Any *value)
 {
 
-    size_t i;
+    int ret;
+
+    const void *k;
+
+    ret = map_iter_next_n (it, &k, NULL, value);
+
+    if (ret != MAP_INVALID)
+        *key = (Key) k;
+
+    return ret;
+
+}
+
 
+/* retreive next binding and its key length from hashmap iterator */
+int
+map_iter_next_n (Iterator it, const void **key, size_t *len, Any *value)
+{
+
+    binding *b;
+
+    hashtable *t;
+
+    hashmap *map;
     hashmap_iterator *iter = it;
 
     if (!iter)
         return MAP_INVALID;
 
-    if (iter->next == iter->map->size) {
+    map = iter->map;
+
+    if (iter->next >= iter_end (map) || iter->next >= iter->end) {
         // no next binding
         *key = NULL;
         *value = NULL;
 
+        if (len)
+            *len = 0;
+
         return MAP_ITERATOR_EXHAUSTED;
     }
 
     // retreive binding
-    *key = iter->map->table[iter->next].key;
-    *value = iter->map->table[iter->next].value;
+    if ((map->flags & MAP_COMPACT) || is_small (map)) {
+        t = &map->table;
+        b = &t->bindings[iter->next];
+    } else if (iter->next < map->table.size) {
+        t = &map->table;
+        b = &t->bindings[iter->next];
+    } else {
+        t = &map->old;
+        b = &t->bindings[iter->next - map->table.size];
+    }
 
-    // increment iterator
-    for (i = ++iter->next; i <= iter->map->size; ++i) {
+    *key = key_of (t, b);
+    *value = b->value;
 
-        iter->next = i;
+    if (len)
+        *len = b->len;
 
-        // slot at index has binding or iterator is exhausted
-        if (i == iter->map->size || iter->map->table[i].key)
-            break;
-    }
+    // increment iterator
+    iter->next = next_binding (map, iter->next + 1);
 
     return MAP_OK;
 
@@ -579,7 +3864,7 @@ int
 map_iter_reset (Iterator it, const Hashmap hm)
 {
 
-    size_t i;
+    int ret;
 
     hashmap *map = hm;
     hashmap_iterator *iter = it;
@@ -587,19 +3872,148 @@ map_iter_reset (Iterator it, const Hashmap hm)
     if (!map || !iter)
         return MAP_INVALID;
 
+    // finish pending migration, which would move bindings past the iterator
+    ret = map->flags & MAP_INCREMENTAL ? migrate (map, SIZE_MAX) : MAP_OK;
+
+    if (ret != MAP_OK)
+        return ret;
+
     // reset map to iterate
     iter->map = map;
 
     // point iterator to first binding
-    for (i = 0; i <= map->size; ++i) {
+    iter->next = next_binding (map, 0);
+    iter->end = SIZE_MAX;
 
-        iter->next = i;
+    return MAP_OK;
+
+}
+
+
+/* divide remaining bindings of hashmap iterator among k new
+ * iterators over disjoint ranges of slots, leaving it exhausted */
+int
+map_iter_split (Iterator it, size_t k, Iterator *out_iters)
+{
+
+    size_t i, start, end, width;
+
+    hashmap_iterator *part;
+    hashmap_iterator *iter = it;
+
+    if (!iter)
+        return MAP_INVALID;
+
+    if (!k)
+        return MAP_INVALID_ARGUMENT;
+
+    end = iter_end (iter->map);
+
+    if (iter->end < end)
+        end = iter->end;
+
+    start = iter->next < end ? iter->next : end;
+    width = (end - start + k - 1) / k;
+
+    for (i = 0; i < k; ++i) {
+
+        part = malloc (sizeof (hashmap_iterator));
+
+        if (!part) {
+            // free previously allocated resources
+            for (; i; --i)
+                map_iter_free (out_iters[i - 1]);
+
+            return MAP_OUT_OF_MEMORY;
+        }
+
+        part->map = iter->map;
+        part->end = end - start > width * (i + 1) ? start + width * (i + 1) : end;
+        part->next = next_binding (iter->map, start + width * i < end ? start + width * i : end);
+
+        out_iters[i] = part;
 
-        // slot at index has binding or iterator is exhausted
-        if (i == map->size || map->table[i].key)
-            break;
     }
 
+    iter->next = end;
+
     return MAP_OK;
 
 }
+
+
+/* call function on bindings of iterator of worker */
+static void *
+foreach_run (void *arg)
+{
+
+    const void *key;
+    size_t len;
+    Any value;
+
+    foreach_worker *w = arg;
+
+    while (map_iter_next_n (w->it, &key, &len, &value) == MAP_OK)
+        w->fn (key, len, value, w->ctx);
+
+    return NULL;
+
+}
+
+
+/* call function on every binding of hashmap from given count of threads */
+int
+map_parallel_foreach (const Hashmap hm, ForeachFunc fn, void *ctx, size_t nthreads)
+{
+
+    int ret;
+
+    size_t i;
+
+    Iterator it;
+    Iterator *parts;
+    foreach_worker *workers;
+
+    if (!hm)
+        return MAP_INVALID;
+
+    if (!fn || !nthreads)
+        return MAP_INVALID_ARGUMENT;
+
+    ret = map_iter_init (&it, hm);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    parts = malloc (nthreads * sizeof (Iterator));
+    workers = calloc (nthreads, sizeof (foreach_worker));
+
+    if (!parts || !workers)
+        ret = MAP_OUT_OF_MEMORY;
+    else
+        ret = map_iter_split (it, nthreads, parts);
+
+    if (ret == MAP_OK) {
+
+        for (i = 0; i < nthreads; ++i) {
+            workers[i].it = parts[i];
+            workers[i].fn = fn;
+            workers[i].ctx = ctx;
+        }
+
+        run_workers (workers, sizeof (foreach_worker), nthreads, foreach_run);
+
+        // iterators are freed once no worker touches the hashmap anymore
+        for (i = 0; i < nthreads; ++i)
+            map_iter_free (parts[i]);
+
+    }
+
+    // free resources
+    map_iter_free (it);
+    free (parts);
+    free (workers);
+
+    return ret;
+
+}
@@ -30,6 +30,14 @@
  **/
 
 
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
 /* ok */
 #define MAP_OK                    1
 
@@ -48,6 +56,75 @@
 /* cannot find slot */
 #define MAP_PROBING_FAILED       -3
 
+/* argument out of range */
+#define MAP_INVALID_ARGUMENT     -4
+
+/* cannot read or write file */
+#define MAP_IO_ERROR             -5
+
+/* file is no hashmap image of this layout */
+#define MAP_INVALID_IMAGE        -6
+
+
+/* robin hood insertion with backward shift deletion */
+#define MAP_ROBIN_HOOD            0x01
+
+/* power of two table size, index by masking hash */
+#define MAP_POW2                  0x02
+
+/* power of two table size, index by fibonacci hashing */
+#define MAP_FIBONACCI             0x04
+
+/* migrate bindings on subsequent operations after resize */
+#define MAP_INCREMENTAL           0x08
+
+/* store copies of keys in memory owned by the hashmap */
+#define MAP_OWN_KEYS              0x10
+
+/* lookups from any thread without locks alongside a single writer */
+#define MAP_CONCURRENT_READS      0x20
+
+/* probe groups at quadratic offsets from home slot */
+#define MAP_QUADRATIC             0x40
+
+/* probe groups at triangular number offsets from home slot */
+#define MAP_TRIANGULAR            0x80
+
+/* bindings in a dense array in insertion order, slots hold indices */
+#define MAP_COMPACT               0x100
+
+/* siphash instead of wyhash unless a hash function is given */
+#define MAP_SIPHASH               0x200
+
+/* up to 8 bindings held inline and scanned before a table is allocated */
+#define MAP_SMALL                 0x400
+
+
+/* count of probe length classes in hashmap statistics */
+#define MAP_STATS_PROBE_LENGTHS   16
+
+
+/* hashmap statistics, counters of resizes
+ * are only kept when built with MAP_STATS */
+typedef struct {
+    /* table size */
+    size_t size;
+    /* binding count */
+    size_t load;
+    /* count of slots marked deleted, of
+     * removed entries in compact mode */
+    size_t deleted;
+    /* bindings by count of groups probed to find them
+     * less one, longer probes are counted in the last class */
+    size_t probe_lengths[MAP_STATS_PROBE_LENGTHS];
+    /* longest run of slots without an empty one */
+    size_t max_run;
+    /* count and cumulative seconds of resizes */
+    size_t resizes;
+    double resize_time;
+
+} MapStats;
+
 
 /* pointer to the internally managed hashmap datastructure */
 typedef void *Hashmap;
@@ -61,28 +138,107 @@ typedef char *Key;
 /* value type */
 typedef void *Any;
 
+/* hash function over key of given length */
+typedef uint64_t (*HashFunc) (const void *key, size_t len, uint64_t seed);
+
+/* function called on each binding with a context pointer */
+typedef void (*ForeachFunc) (const void *key, size_t len, Any value, void *ctx);
+
+/* function updating value in place, NULL if just inserted, with a context pointer */
+typedef void (*UpsertFunc) (Any *value, int inserted, void *ctx);
+
 
 /* initialize hashmap */
 extern int map_init (Hashmap *hm);
 
+/* initialize hashmap with given mode flags */
+extern int map_init_with_flags (Hashmap *hm, int flags);
+
+/* initialize hashmap with given mode flags, hash function, NULL for default,
+ * and seed, which the other initializers draw at random for each hashmap */
+extern int map_init_with_hash (Hashmap *hm, int flags, HashFunc hash, uint64_t seed);
+
+/* initialize hashmap with room for given count of bindings */
+extern int map_init_with_capacity (Hashmap *hm, size_t capacity);
+
 /* delete hashmap */
 extern int map_free (Hashmap hm);
 
 /* retreive value from hashmap */
 extern int map_lookup (const Hashmap hm, const Key key, Any *value);
 
+/* retreive values of n keys from hashmap, result code of each key in results */
+extern int map_lookup_batch (const Hashmap hm, const Key *keys, size_t n, Any *values, int *results);
+
 /* update key or create new binding if not exists */
 extern int map_insert (Hashmap hm, const Key key, const Any value);
 
+/* insert n keys with their values at once using given count of threads */
+extern int map_insert_bulk (Hashmap hm, const Key *keys, const Any *values, size_t n, size_t nthreads);
+
+/* retreive pointer to value of key, valid until the next modification,
+ * creating binding with NULL value if not exists, not in concurrent mode */
+extern int map_entry (Hashmap hm, const Key key, Any **value, int *inserted);
+
+/* apply function to value of key, creating binding if not exists,
+ * function is not called if creating the binding fails */
+extern int map_upsert (Hashmap hm, const Key key, UpsertFunc fn, void *ctx);
+
 /* remove binding from hashmap */
 extern int map_remove (Hashmap hm, const Key key);
 
 /* test if hashmap contains binding with given key */
 extern int map_contains (const Hashmap hm, const Key key);
 
+/* retreive value from hashmap by binary key of given length */
+extern int map_lookup_n (const Hashmap hm, const void *key, size_t len, Any *value);
+
+/* update binary key of given length or create new binding if not exists */
+extern int map_insert_n (Hashmap hm, const void *key, size_t len, const Any value);
+
+/* retreive pointer to value of binary key of given length, creating binding if not exists */
+extern int map_entry_n (Hashmap hm, const void *key, size_t len, Any **value, int *inserted);
+
+/* apply function to value of binary key of given length, creating binding if not exists,
+ * function is not called if creating the binding fails */
+extern int map_upsert_n (Hashmap hm, const void *key, size_t len, UpsertFunc fn, void *ctx);
+
+/* remove binding with binary key of given length from hashmap */
+extern int map_remove_n (Hashmap hm, const void *key, size_t len);
+
+/* test if hashmap contains binding with binary key of given length */
+extern int map_contains_n (const Hashmap hm, const void *key, size_t len);
+
 /* retreive current count of bindings from hashmap*/
 extern int map_count (const Hashmap hm, size_t *count);
 
+/* retreive statistics of hashmap */
+extern int map_stats (const Hashmap hm, MapStats *stats);
+
+/* make room for given count of bindings without further resizes */
+extern int map_reserve (Hashmap hm, size_t count);
+
+/* shrink table to smallest size holding current bindings */
+extern int map_shrink_to_fit (Hashmap hm);
+
+/* remove all bindings while keeping table size */
+extern int map_clear (Hashmap hm);
+
+/* set ratio of bindings to table size triggering a resize, between 0 and 1 */
+extern int map_set_load_factor (Hashmap hm, double load_factor);
+
+/* set factor by which the table size grows, greater than 1 */
+extern int map_set_growth_rate (Hashmap hm, double growth_rate);
+
+/* free tables and keys replaced by the writer since concurrent lookups may have read them */
+extern int map_reclaim (Hashmap hm);
+
+/* write position independent image of hashmap to file, hash must be one of map_hash_* */
+extern int map_save (const Hashmap hm, const char *path);
+
+/* open hashmap served from mapped image file, copied into memory on first modification */
+extern int map_open_mmap (Hashmap *hm, const char *path);
+
 /* initialize hashmap iterator */
 extern int map_iter_init (Iterator *it, const Hashmap hm);
 
@@ -95,7 +251,33 @@ extern int map_iter_has_next (const Iterator it);
 /* retreive next binding from hashmap iterator */
 extern int map_iter_next (Iterator it, Key *key, Any *value);
 
+/* retreive next binding and its key length from hashmap iterator, len may be NULL */
+extern int map_iter_next_n (Iterator it, const void **key, size_t *len, Any *value);
+
 /* reset hashmap iterator */
 extern int map_iter_reset (Iterator it, const Hashmap hm);
 
+/* divide remaining bindings of iterator among k new disjoint iterators, leaving it exhausted */
+extern int map_iter_split (Iterator it, size_t k, Iterator *out_iters);
+
+/* call function on every binding from given count of threads, which must not modify the hashmap */
+extern int map_parallel_foreach (const Hashmap hm, ForeachFunc fn, void *ctx, size_t nthreads);
+
+
+/* djb2, one byte per iteration */
+extern uint64_t map_hash_djb2 (const void *key, size_t len, uint64_t seed);
+
+/* wyhash, 16 bytes per iteration */
+extern uint64_t map_hash_wyhash (const void *key, size_t len, uint64_t seed);
+
+/* xxh64, 32 bytes per iteration */
+extern uint64_t map_hash_xxh64 (const void *key, size_t len, uint64_t seed);
+
+/* siphash-1-3 keyed by seed, 8 bytes per iteration */
+extern uint64_t map_hash_siphash (const void *key, size_t len, uint64_t seed);
+
+/* seed drawn from the random secret of the process, different on every call */
+extern uint64_t map_random_seed (void);
+
 
+#endif
@@ -0,0 +1,780 @@
+/**
+ * hashset.c
+ *
+ * implementation of an open addressing hashset of keys without values,
+ * probed over groups of control tags like the hashmap.
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "group.h"
+#include "hashset.h"
+
+
+/* initial table size, power of two */
+#define INITIAL_SIZE                    256
+
+/* exceeding this ratio between keys plus deleted
+ * slots and table size will trigger a resize operation */
+#define LOAD_FACTOR                     0.875
+
+/* largest table size, home slots are taken from
+ * the upper half of hashes which entries cache */
+#define MAX_SIZE                        ((uint64_t) 1 << 32)
+
+/* hash function used unless given on initialization */
+#define DEFAULT_HASH                    map_hash_wyhash
+
+
+typedef struct {
+    /* unique key */
+    Key key;
+    /* length of key */
+    uint32_t len;
+    /* upper half of hash of key, the control
+     * tag of the slot holds bits of the lower */
+    uint32_t hash;
+
+} entry;
+
+
+typedef struct {
+    /* key count */
+    size_t load;
+    /* table size, power of two */
+    size_t size;
+    /* count of slots marked deleted */
+    size_t deleted;
+    /* shift taking the table index from the top bits of the hash */
+    int shift;
+    /* hash function and seed */
+    HashFunc hash;
+    uint64_t seed;
+    /* control tags of slots and their clones */
+    int8_t *ctrl;
+    /* entries */
+    entry *entries;
+
+} hashset;
+
+
+typedef struct {
+    /* index of next key */
+    size_t next;
+    /* set to iterate */
+    hashset *set;
+
+} hashset_iterator;
+
+
+/* home slot of hash */
+static inline size_t
+home (const hashset *set, uint64_t h)
+{
+
+    return (size_t) (h >> set->shift);
+
+}
+
+
+/* hash of entry in slot as far as it is kept, enough
+ * to find its home slot and tag in any table size */
+static inline uint64_t
+cached_hash (const hashset *set, size_t idx)
+{
+
+    return (uint64_t) set->entries[idx].hash << 32 | (uint8_t) set->ctrl[idx];
+
+}
+
+
+/* test if two sets hash keys alike */
+static inline int
+same_hash (const hashset *a, const hashset *b)
+{
+
+    return a->hash == b->hash && a->seed == b->seed;
+
+}
+
+
+/* allocate empty table of given power of two size */
+static int
+alloc_table (hashset *set, size_t size)
+{
+
+    int8_t *ctrl;
+    entry *entries;
+
+    if ((uint64_t) size > MAX_SIZE)
+        return MAP_OUT_OF_MEMORY;
+
+    ctrl = ctrl_alloc (size);
+
+    if (!ctrl)
+        return MAP_OUT_OF_MEMORY;
+
+    entries = malloc (size * sizeof (entry));
+
+    if (!entries) {
+        // free previously allocated resources
+        free (ctrl);
+
+        return MAP_OUT_OF_MEMORY;
+    }
+
+    set->shift = table_shift (size);
+    set->size = size;
+    set->deleted = 0;
+    set->ctrl = ctrl;
+    set->entries = entries;
+
+    return MAP_OK;
+
+}
+
+
+/* find slot with matching key */
+static int
+find_key (const hashset *set, const void *key, uint64_t h, size_t len, size_t *index)
+{
+
+    size_t slot;
+
+    entry *e;
+
+    ctrl_probe p;
+
+    // linear probing over groups from slot index for key
+    ctrl_probe_init (&p, set->ctrl, home (set, h), CTRL_TAG (h));
+
+    while (ctrl_probe_next (&p, set->ctrl, set->size, &slot)) {
+
+        e = &set->entries[slot];
+
+        // compare cached hash and length first
+        if (e->hash == (uint32_t) (h >> 32) && e->len == len && !memcmp (e->key, key, len)) {
+            // retreive index
+            *index = slot;
+
+            return MAP_OK;
+        }
+    }
+
+    return MAP_KEY_NOT_FOUND;
+
+}
+
+/* insert key known not to be in table at first free slot */
+static void
+insert_entry (hashset *set, Key key, uint64_t h, size_t len)
+{
+
+    size_t idx = ctrl_find_free (set->ctrl, set->size, home (set, h));
+
+    // reuse deleted slot
+    if (ctrl_claim (set->ctrl, set->size, idx, CTRL_TAG (h)))
+        --set->deleted;
+
+    set->entries[idx].key = key;
+    set->entries[idx].len = (uint32_t) len;
+    set->entries[idx].hash = (uint32_t) (h >> 32);
+
+}
+
+/* rehash all keys into a table of given size */
+static int
+resize (hashset *set, size_t size)
+{
+
+    int ret;
+
+    size_t i;
+
+    // backup old table
+    hashset old = *set;
+
+    // allocate new table
+    ret = alloc_table (set, size);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    // rehash by cached part of hashes
+    for (i = 0; i < old.size; ++i) {
+
+        if (old.ctrl[i] >= 0)
+            insert_entry (set, old.entries[i].key, cached_hash (&old, i), old.entries[i].len);
+
+    }
+
+    free (old.ctrl);
+    free (old.entries);
+
+    return MAP_OK;
+
+}
+
+
+/* add key with given hash unless contained */
+static int
+add (hashset *set, const void *key, uint64_t h, size_t len)
+{
+
+    int ret;
+
+    size_t idx;
+
+    // entries keep 32 bits of length
+    if ((uint64_t) len > UINT32_MAX)
+        return MAP_INVALID_ARGUMENT;
+
+    if (find_key (set, key, h, len, &idx) == MAP_OK)
+        return MAP_OK;
+
+    // keys and deleted slots exceed threshold
+    if (table_full (set->size, set->load, set->deleted, LOAD_FACTOR)) {
+        // double table unless mostly deleted slots need to be purged
+        if (table_grows (set->size, set->load, LOAD_FACTOR, 2))
+            ret = resize (set, set->size << 1);
+        else
+            ret = resize (set, set->size);
+
+        if (ret != MAP_OK)
+            return ret;
+    }
+
+    insert_entry (set, (Key) key, h, len);
+
+    ++set->load;
+
+    return MAP_OK;
+
+}
+
+
+/* remove key in slot at index */
+static void
+remove_at (hashset *set, size_t idx)
+{
+
+    // mark slot empty unless probe sequences pass through it
+    if (ctrl_release (set->ctrl, set->size, idx))
+        ++set->deleted;
+
+    --set->load;
+
+}
+
+
+/* find slot of set holding the key in slot of other set, reusing
+ * the cached part of its hash if both sets hash alike */
+static int
+find_entry (const hashset *set, const hashset *other, size_t idx, size_t *index)
+{
+
+    entry *e = &other->entries[idx];
+
+    uint64_t h = same_hash (set, other) ? cached_hash (other, idx) : set->hash (e->key, e->len, set->seed);
+
+    return find_key (set, e->key, h, e->len, index);
+
+}
+
+
+/* seed shared by the sets of the process, drawn at random on first use so that
+ * sets hash alike and their unions and intersections reuse cached hashes */
+static uint64_t
+shared_seed (void)
+{
+
+    static uint64_t seed;
+
+    uint64_t s = __atomic_load_n (&seed, __ATOMIC_RELAXED);
+
+    // racing first calls each store a random seed of their own
+    if (!s) {
+        s = map_random_seed () | 1;
+
+        __atomic_store_n (&seed, s, __ATOMIC_RELAXED);
+    }
+
+    return s;
+
+}
+
+
+/* allocate hashset with table of given size */
+static int
+create (Hashset *hs, HashFunc hash, uint64_t seed, size_t size)
+{
+
+    int ret;
+
+    hashset *set = malloc (sizeof (hashset));
+
+    if (!set)
+        return MAP_OUT_OF_MEMORY;
+
+    set->load = 0;
+    set->hash = hash ? hash : DEFAULT_HASH;
+    set->seed = seed;
+
+    ret = alloc_table (set, size);
+
+    if (ret != MAP_OK) {
+        // free previously allocated resources
+        free (set);
+
+        return ret;
+    }
+
+    *hs = set;
+
+    return MAP_OK;
+
+}
+
+
+/* initialize hashset */
+int
+set_init (Hashset *hs)
+{
+
+    return create (hs, NULL, shared_seed (), INITIAL_SIZE);
+
+}
+
+
+/* initialize hashset with custom hash function and seed */
+int
+set_init_with_hash (Hashset *hs, HashFunc hash, uint64_t seed)
+{
+
+    return create (hs, hash, seed, INITIAL_SIZE);
+
+}
+
+
+/* initialize hashset with room for given count of keys */
+int
+set_init_with_capacity (Hashset *hs, size_t capacity)
+{
+
+    return create (hs, NULL, shared_seed (), table_fitting_size (capacity, LOAD_FACTOR));
+
+}
+
+
+/* delete hashset */
+int
+set_free (Hashset hs)
+{
+
+    hashset *set = hs;
+
+    if (!set)
+        return MAP_INVALID;
+
+    free (set->ctrl);
+    free (set->entries);
+    free (set);
+
+    return MAP_OK;
+
+}
+
+
+/* add key to hashset if not contained yet */
+int
+set_insert (Hashset hs, const Key key)
+{
+
+    return set_insert_n (hs, key, strlen (key));
+
+}
+
+
+/* remove key from hashset */
+int
+set_remove (Hashset hs, const Key key)
+{
+
+    return set_remove_n (hs, key, strlen (key));
+
+}
+
+
+/* test if hashset contains given key */
+int
+set_contains (const Hashset hs, const Key key)
+{
+
+    return set_contains_n (hs, key, strlen (key));
+
+}
+
+
+/* add binary key of given length to hashset if not contained yet */
+int
+set_insert_n (Hashset hs, const void *key, size_t len)
+{
+
+    hashset *set = hs;
+
+    if (!set)
+        return MAP_INVALID;
+
+    return add (set, key, set->hash (key, len, set->seed), len);
+
+}
+
+
+/* remove binary key of given length from hashset */
+int
+set_remove_n (Hashset hs, const void *key, size_t len)
+{
+
+    size_t idx;
+
+    hashset *set = hs;
+
+    if (!set)
+        return MAP_INVALID;
+
+    if (find_key (set, key, set->hash (key, len, set->seed), len, &idx) != MAP_OK)
+        return MAP_KEY_NOT_FOUND;
+
+    remove_at (set, idx);
+
+    return MAP_OK;
+
+}
+
+
+/* test if hashset contains binary key of given length */
+int
+set_contains_n (const Hashset hs, const void *key, size_t len)
+{
+
+    size_t idx;
+
+    hashset *set = hs;
+
+    if (!set)
+        return MAP_INVALID;
+
+    return find_key (set, key, set->hash (key, len, set->seed), len, &idx);
+
+}
+
+
+/* retreive current count of keys from hashset */
+int
+set_count (const Hashset hs, size_t *count)
+{
+
+    hashset *set = hs;
+
+    if (!set)
+        return MAP_INVALID;
+
+    *count = set->load;
+
+    return MAP_OK;
+
+}
+
+
+/* add all keys of other hashset in one pass over its table, sized
+ * upfront and reusing cached hashes if both sets hash alike */
+int
+set_union (Hashset hs, const Hashset other)
+{
+
+    int ret;
+
+    size_t i, size;
+
+    uint64_t h;
+
+    entry *e;
+
+    hashset *set = hs;
+    hashset *from = other;
+
+    if (!set || !from)
+        return MAP_INVALID;
+
+    if (set == from)
+        return MAP_OK;
+
+    size = table_fitting_size (set->load + from->load, LOAD_FACTOR);
+
+    // make room for all keys at once
+    if (size > set->size) {
+        ret = resize (set, size);
+
+        if (ret != MAP_OK)
+            return ret;
+    }
+
+    for (i = 0; i < from->size; ++i) {
+
+        if (from->ctrl[i] < 0)
+            continue;
+
+        e = &from->entries[i];
+        h = same_hash (set, from) ? cached_hash (from, i) : set->hash (e->key, e->len, set->seed);
+
+        ret = add (set, e->key, h, e->len);
+
+        if (ret != MAP_OK)
+            return ret;
+
+    }
+
+    return MAP_OK;
+
+}
+
+
+/* remove all keys not contained in other hashset in one pass over the table */
+int
+set_intersect (Hashset hs, const Hashset other)
+{
+
+    size_t i, idx;
+
+    hashset *set = hs;
+    hashset *with = other;
+
+    if (!set || !with)
+        return MAP_INVALID;
+
+    for (i = 0; i < set->size; ++i) {
+
+        if (set->ctrl[i] >= 0 && find_entry (with, set, i, &idx) != MAP_OK)
+            remove_at (set, i);
+
+    }
+
+    return MAP_OK;
+
+}
+
+
+/* remove all keys contained in other hashset in one pass
+ * over the table of whichever of both holds fewer keys */
+int
+set_difference (Hashset hs, const Hashset other)
+{
+
+    size_t i, idx;
+
+    hashset *set = hs;
+    hashset *without = other;
+
+    if (!set || !without)
+        return MAP_INVALID;
+
+    // set minus itself, empty the table
+    if (set == without) {
+        ctrl_clear (set->ctrl, set->size);
+
+        set->load = 0;
+        set->deleted = 0;
+
+        return MAP_OK;
+    }
+
+    if (without->load < set->load) {
+        // look keys of other set up in set
+        for (i = 0; i < without->size; ++i) {
+
+            if (without->ctrl[i] >= 0 && find_entry (set, without, i, &idx) == MAP_OK)
+                remove_at (set, idx);
+
+        }
+    } else {
+        // look keys of set up in other set
+        for (i = 0; i < set->size; ++i) {
+
+            if (set->ctrl[i] >= 0 && find_entry (without, set, i, &idx) == MAP_OK)
+                remove_at (set, i);
+
+        }
+    }
+
+    return MAP_OK;
+
+}
+
+
+/* initialize hashset iterator */
+int
+set_iter_init (Iterator *it, const Hashset hs)
+{
+
+    hashset_iterator *iter;
+
+    hashset *set = hs;
+
+    if (!set)
+        return MAP_INVALID;
+
+    iter = malloc (sizeof (hashset_iterator));
+
+    if (!iter)
+        return MAP_OUT_OF_MEMORY;
+
+    // set set to iterate
+    iter->set = set;
+
+    // point iterator to first key
+    iter->next = ctrl_next_full (set->ctrl, set->size, 0);
+
+    *it = iter;
+
+    return MAP_OK;
+
+}
+
+/* delete hashset iterator */
+int
+set_iter_free (Iterator it)
+{
+
+    hashset_iterator *iter = it;
+
+    if (!iter)
+        return MAP_INVALID;
+
+    free (iter);
+
+    return MAP_OK;
+
+}
+
+
+/* test for next key in hashset iterator */
+int
+set_iter_has_next (const Iterator it)
+{
+
+    hashset_iterator *iter = it;
+
+    if (!iter)
+        return MAP_INVALID;
+
+    if (iter->next >= iter->set->size)
+        return MAP_ITERATOR_EXHAUSTED;
+
+    return MAP_OK;
+
+}
+
+
+/* retreive next key from hashset iterator */
+int
+set_iter_next (Iterator it, Key *key)
+{
+
+    int ret;
+
+    const void *k;
+
+    ret = set_iter_next_n (it, &k, NULL);
+
+    if (ret != MAP_INVALID)
+        *key = (Key) k;
+
+    return ret;
+
+}
+
+
+/* retreive next key and its length from hashset iterator */
+int
+set_iter_next_n (Iterator it, const void **key, size_t *len)
+{
+
+    hashset_iterator *iter = it;
+
+    if (!iter)
+        return MAP_INVALID;
+
+    if (iter->next >= iter->set->size) {
+        // no next key
+        *key = NULL;
+
+        if (len)
+            *len = 0;
+
+        return MAP_ITERATOR_EXHAUSTED;
+    }
+
+    // retreive key
+    *key = iter->set->entries[iter->next].key;
+
+    if (len)
+        *len = iter->set->entries[iter->next].len;
+
+    // increment iterator
+    iter->next = ctrl_next_full (iter->set->ctrl, iter->set->size, iter->next + 1);
+
+    return MAP_OK;
+
+}
+
+
+/* reset hashset iterator */
+int
+set_iter_reset (Iterator it, const Hashset hs)
+{
+
+    hashset *set = hs;
+    hashset_iterator *iter = it;
+
+    if (!set || !iter)
+        return MAP_INVALID;
+
+    // reset set to iterate
+    iter->set = set;
+
+    // point iterator to first key
+    iter->next = ctrl_next_full (set->ctrl, set->size, 0);
+
+    return MAP_OK;
+
+}
@@ -0,0 +1,108 @@
+/**
+ * hashset.h
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#ifndef HASHSET_H
+#define HASHSET_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hashmap.h"
+
+
+/* pointer to the internally managed hashset datastructure */
+typedef void *Hashset;
+
+
+/* initialize hashset */
+extern int set_init (Hashset *hs);
+
+/* initialize hashset with custom hash function and seed */
+extern int set_init_with_hash (Hashset *hs, HashFunc hash, uint64_t seed);
+
+/* initialize hashset with room for given count of keys */
+extern int set_init_with_capacity (Hashset *hs, size_t capacity);
+
+/* delete hashset */
+extern int set_free (Hashset hs);
+
+/* add key to hashset if not contained yet */
+extern int set_insert (Hashset hs, const Key key);
+
+/* remove key from hashset */
+extern int set_remove (Hashset hs, const Key key);
+
+/* test if hashset contains given key */
+extern int set_contains (const Hashset hs, const Key key);
+
+/* add binary key of given length to hashset if not contained yet */
+extern int set_insert_n (Hashset hs, const void *key, size_t len);
+
+/* remove binary key of given length from hashset */
+extern int set_remove_n (Hashset hs, const void *key, size_t len);
+
+/* test if hashset contains binary key of given length */
+extern int set_contains_n (const Hashset hs, const void *key, size_t len);
+
+/* retreive current count of keys from hashset */
+extern int set_count (const Hashset hs, size_t *count);
+
+/* add all keys of other hashset to hashset */
+extern int set_union (Hashset hs, const Hashset other);
+
+/* remove all keys from hashset that other hashset does not contain */
+extern int set_intersect (Hashset hs, const Hashset other);
+
+/* remove all keys from hashset that other hashset contains */
+extern int set_difference (Hashset hs, const Hashset other);
+
+/* initialize hashset iterator */
+extern int set_iter_init (Iterator *it, const Hashset hs);
+
+/* delete hashset iterator */
+extern int set_iter_free (Iterator it);
+
+/* test for next key in hashset iterator */
+extern int set_iter_has_next (const Iterator it);
+
+/* retreive next key from hashset iterator */
+extern int set_iter_next (Iterator it, Key *key);
+
+/* retreive next key and its length from hashset iterator, len may be NULL */
+extern int set_iter_next_n (Iterator it, const void **key, size_t *len);
+
+/* reset hashset iterator */
+extern int set_iter_reset (Iterator it, const Hashset hs);
+
+
+#endif
@@ -0,0 +1,537 @@
+/**
+ * intmap.c
+ *
+ * implementation of an open addressing hashmap keyed by 64 bit integers,
+ * stored inline in the slots and probed over groups of control tags.
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "group.h"
+#include "intmap.h"
+
+
+/* initial table size, power of two */
+#define INITIAL_SIZE                    256
+
+/* exceeding this ratio between bindings plus deleted
+ * slots and table size will trigger a resize operation */
+#define LOAD_FACTOR                     0.875
+
+/* multiplier of the integer mixer */
+#define MIX_MULTIPLIER                  0xd6e8feb86659fd93ull
+
+
+typedef struct {
+    /* unique key */
+    uint64_t key;
+    /* any value */
+    Any value;
+
+} binding;
+
+
+typedef struct {
+    /* binding count */
+    size_t load;
+    /* table size, power of two */
+    size_t size;
+    /* count of slots marked deleted */
+    size_t deleted;
+    /* shift taking the table index from the top bits of the hash */
+    int shift;
+    /* seed of the mixer */
+    uint64_t seed;
+    /* control tags of slots and their clones */
+    int8_t *ctrl;
+    /* bindings */
+    binding *bindings;
+
+} intmap;
+
+
+typedef struct {
+    /* index of next binding */
+    size_t next;
+    /* map to iterate */
+    intmap *map;
+
+} intmap_iterator;
+
+
+/* spread bits of key under given seed over the whole word, the tag
+ * is taken from the low bits and the home slot from the high bits */
+static inline uint64_t
+mix (uint64_t key, uint64_t seed)
+{
+
+    key ^= seed;
+    key ^= key >> 32;
+    key *= MIX_MULTIPLIER;
+    key ^= key >> 32;
+
+    return key;
+
+}
+
+
+/* home slot of hash */
+static inline size_t
+home (const intmap *map, uint64_t h)
+{
+
+    return (size_t) (h >> map->shift);
+
+}
+
+
+/* allocate empty table of given power of two size */
+static int
+alloc_table (intmap *map, size_t size)
+{
+
+    int8_t *ctrl;
+    binding *bindings;
+
+    ctrl = ctrl_alloc (size);
+
+    if (!ctrl)
+        return MAP_OUT_OF_MEMORY;
+
+    bindings = malloc (size * sizeof (binding));
+
+    if (!bindings) {
+        // free previously allocated resources
+        free (ctrl);
+
+        return MAP_OUT_OF_MEMORY;
+    }
+
+    map->shift = table_shift (size);
+    map->size = size;
+    map->deleted = 0;
+    map->ctrl = ctrl;
+    map->bindings = bindings;
+
+    return MAP_OK;
+
+}
+
+
+/* find slot with matching key */
+static int
+find_key (const intmap *map, uint64_t key, uint64_t h, size_t *index)
+{
+
+    size_t slot;
+
+    ctrl_probe p;
+
+    // linear probing over groups from slot index for key
+    ctrl_probe_init (&p, map->ctrl, home (map, h), CTRL_TAG (h));
+
+    while (ctrl_probe_next (&p, map->ctrl, map->size, &slot)) {
+
+        if (map->bindings[slot].key == key) {
+            // retreive index
+            *index = slot;
+
+            return MAP_OK;
+        }
+    }
+
+    return MAP_KEY_NOT_FOUND;
+
+}
+
+/* insert binding known not to be in table at first free slot */
+static void
+insert_binding (intmap *map, uint64_t key, Any value)
+{
+
+    uint64_t h = mix (key, map->seed);
+
+    size_t idx = ctrl_find_free (map->ctrl, map->size, home (map, h));
+
+    // reuse deleted slot
+    if (ctrl_claim (map->ctrl, map->size, idx, CTRL_TAG (h)))
+        --map->deleted;
+
+    map->bindings[idx].key = key;
+    map->bindings[idx].value = value;
+
+}
+
+/* rehash all keys into a table of given size */
+static int
+resize (intmap *map, size_t size)
+{
+
+    int ret;
+
+    size_t i;
+
+    // backup old table
+    intmap old = *map;
+
+    // allocate new table
+    ret = alloc_table (map, size);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    // rehash, mixing keys again is cheaper than caching hashes
+    for (i = 0; i < old.size; ++i) {
+
+        if (old.ctrl[i] >= 0)
+            insert_binding (map, old.bindings[i].key, old.bindings[i].value);
+
+    }
+
+    free (old.ctrl);
+    free (old.bindings);
+
+    return MAP_OK;
+
+}
+
+
+/* allocate integer keyed hashmap with table of given size */
+static int
+create (Intmap *im, size_t size)
+{
+
+    int ret;
+
+    intmap *map = malloc (sizeof (intmap));
+
+    if (!map)
+        return MAP_OUT_OF_MEMORY;
+
+    map->load = 0;
+    map->seed = map_random_seed ();
+
+    ret = alloc_table (map, size);
+
+    if (ret != MAP_OK) {
+        // free previously allocated resources
+        free (map);
+
+        return ret;
+    }
+
+    *im = map;
+
+    return MAP_OK;
+
+}
+
+
+/* initialize integer keyed hashmap */
+int
+intmap_init (Intmap *im)
+{
+
+    return create (im, INITIAL_SIZE);
+
+}
+
+
+/* initialize integer keyed hashmap with room for given count of bindings */
+int
+intmap_init_with_capacity (Intmap *im, size_t capacity)
+{
+
+    return create (im, table_fitting_size (capacity, LOAD_FACTOR));
+
+}
+
+
+/* delete integer keyed hashmap */
+int
+intmap_free (Intmap im)
+{
+
+    intmap *map = im;
+
+    if (!map)
+        return MAP_INVALID;
+
+    free (map->ctrl);
+    free (map->bindings);
+    free (map);
+
+    return MAP_OK;
+
+}
+
+
+/* retreive value of given key from integer keyed hashmap */
+int
+intmap_lookup (const Intmap im, uint64_t key, Any *value)
+{
+
+    size_t idx;
+
+    intmap *map = im;
+
+    if (!map)
+        return MAP_INVALID;
+
+    if (find_key (map, key, mix (key, map->seed), &idx) != MAP_OK)
+        return MAP_KEY_NOT_FOUND;
+
+    // retreive value
+    *value = map->bindings[idx].value;
+
+    return MAP_OK;
+
+}
+
+
+/* update key or create new binding if not exists */
+int
+intmap_insert (Intmap im, uint64_t key, const Any value)
+{
+
+    int ret;
+
+    size_t idx;
+
+    intmap *map = im;
+
+    if (!map)
+        return MAP_INVALID;
+
+    // update value of existing binding
+    if (find_key (map, key, mix (key, map->seed), &idx) == MAP_OK) {
+        map->bindings[idx].value = value;
+
+        return MAP_OK;
+    }
+
+    // bindings and deleted slots exceed threshold
+    if (table_full (map->size, map->load, map->deleted, LOAD_FACTOR)) {
+        // double table unless mostly deleted slots need to be purged
+        if (table_grows (map->size, map->load, LOAD_FACTOR, 2))
+            ret = resize (map, map->size << 1);
+        else
+            ret = resize (map, map->size);
+
+        if (ret != MAP_OK)
+            return ret;
+    }
+
+    insert_binding (map, key, value);
+
+    ++map->load;
+
+    return MAP_OK;
+
+}
+
+
+/* remove binding from integer keyed hashmap */
+int
+intmap_remove (Intmap im, uint64_t key)
+{
+
+    size_t idx;
+
+    intmap *map = im;
+
+    if (!map)
+        return MAP_INVALID;
+
+    if (find_key (map, key, mix (key, map->seed), &idx) != MAP_OK)
+        return MAP_KEY_NOT_FOUND;
+
+    // mark slot empty unless probe sequences pass through it
+    if (ctrl_release (map->ctrl, map->size, idx))
+        ++map->deleted;
+
+    --map->load;
+
+    return MAP_OK;
+
+}
+
+
+/* test if integer keyed hashmap contains binding with given key */
+int
+intmap_contains (const Intmap im, uint64_t key)
+{
+
+    size_t idx;
+
+    intmap *map = im;
+
+    if (!map)
+        return MAP_INVALID;
+
+    return find_key (map, key, mix (key, map->seed), &idx);
+
+}
+
+
+/* retreive current count of bindings from integer keyed hashmap */
+int
+intmap_count (const Intmap im, size_t *count)
+{
+
+    intmap *map = im;
+
+    if (!map)
+        return MAP_INVALID;
+
+    *count = map->load;
+
+    return MAP_OK;
+
+}
+
+
+/* initialize integer keyed hashmap iterator */
+int
+intmap_iter_init (Iterator *it, const Intmap im)
+{
+
+    intmap_iterator *iter;
+
+    intmap *map = im;
+
+    if (!map)
+        return MAP_INVALID;
+
+    iter = malloc (sizeof (intmap_iterator));
+
+    if (!iter)
+        return MAP_OUT_OF_MEMORY;
+
+    // set map to iterate
+    iter->map = map;
+
+    // point iterator to first binding
+    iter->next = ctrl_next_full (map->ctrl, map->size, 0);
+
+    *it = iter;
+
+    return MAP_OK;
+
+}
+
+/* delete integer keyed hashmap iterator */
+int
+intmap_iter_free (Iterator it)
+{
+
+    intmap_iterator *iter = it;
+
+    if (!iter)
+        return MAP_INVALID;
+
+    free (iter);
+
+    return MAP_OK;
+
+}
+
+
+/* test for next binding in integer keyed hashmap iterator */
+int
+intmap_iter_has_next (const Iterator it)
+{
+
+    intmap_iterator *iter = it;
+
+    if (!iter)
+        return MAP_INVALID;
+
+    if (iter->next >= iter->map->size)
+        return MAP_ITERATOR_EXHAUSTED;
+
+    return MAP_OK;
+
+}
+
+
+/* retreive next binding from integer keyed hashmap iterator */
+int
+intmap_iter_next (Iterator it, uint64_t *key, Any *value)
+{
+
+    intmap_iterator *iter = it;
+
+    if (!iter)
+        return MAP_INVALID;
+
+    if (iter->next >= iter->map->size) {
+        // no next binding
+        *key = 0;
+        *value = NULL;
+
+        return MAP_ITERATOR_EXHAUSTED;
+    }
+
+    // retreive binding
+    *key = iter->map->bindings[iter->next].key;
+    *value = iter->map->bindings[iter->next].value;
+
+    // increment iterator
+    iter->next = ctrl_next_full (iter->map->ctrl, iter->map->size, iter->next + 1);
+
+    return MAP_OK;
+
+}
+
+
+/* reset integer keyed hashmap iterator */
+int
+intmap_iter_reset (Iterator it, const Intmap im)
+{
+
+    intmap *map = im;
+    intmap_iterator *iter = it;
+
+    if (!map || !iter)
+        return MAP_INVALID;
+
+    // reset map to iterate
+    iter->map = map;
+
+    // point iterator to first binding
+    iter->next = ctrl_next_full (map->ctrl, map->size, 0);
+
+    return MAP_OK;
+
+}
@@ -0,0 +1,87 @@
+/**
+ * intmap.h
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#ifndef INTMAP_H
+#define INTMAP_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hashmap.h"
+
+
+/* pointer to the internally managed integer keyed hashmap datastructure */
+typedef void *Intmap;
+
+
+/* initialize integer keyed hashmap */
+extern int intmap_init (Intmap *im);
+
+/* initialize integer keyed hashmap with room for given count of bindings */
+extern int intmap_init_with_capacity (Intmap *im, size_t capacity);
+
+/* delete integer keyed hashmap */
+extern int intmap_free (Intmap im);
+
+/* retreive value from integer keyed hashmap */
+extern int intmap_lookup (const Intmap im, uint64_t key, Any *value);
+
+/* update key or create new binding if not exists */
+extern int intmap_insert (Intmap im, uint64_t key, const Any value);
+
+/* remove binding from integer keyed hashmap */
+extern int intmap_remove (Intmap im, uint64_t key);
+
+/* test if integer keyed hashmap contains binding with given key */
+extern int intmap_contains (const Intmap im, uint64_t key);
+
+/* retreive current count of bindings from integer keyed hashmap */
+extern int intmap_count (const Intmap im, size_t *count);
+
+/* initialize integer keyed hashmap iterator */
+extern int intmap_iter_init (Iterator *it, const Intmap im);
+
+/* delete integer keyed hashmap iterator */
+extern int intmap_iter_free (Iterator it);
+
+/* test for next binding in integer keyed hashmap iterator */
+extern int intmap_iter_has_next (const Iterator it);
+
+/* retreive next binding from integer keyed hashmap iterator */
+extern int intmap_iter_next (Iterator it, uint64_t *key, Any *value);
+
+/* reset integer keyed hashmap iterator */
+extern int intmap_iter_reset (Iterator it, const Intmap im);
+
+
+#endif
@@ -0,0 +1,427 @@
+/**
+ * lru.c
+ *
+ * implementation of a bounded cache evicting the least recently used
+ * binding, a hashmap from keys to nodes of a circular recency list.
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashed.h"
+#include "lru.h"
+
+
+typedef struct _lru_node {
+    /* neighbours toward the most and the least recently used */
+    struct _lru_node *prev;
+    struct _lru_node *next;
+    /* any value */
+    Any value;
+    /* used since passed over for eviction, in clock mode */
+    int referenced;
+    /* length of key */
+    size_t len;
+    /* copy of key, stored right behind the node */
+    char *key;
+
+} lru_node;
+
+
+typedef struct {
+    /* binding count and largest binding count */
+    size_t load;
+    size_t capacity;
+    /* policy flags */
+    int flags;
+    /* hashmap from keys to their nodes */
+    Hashmap map;
+    /* sentinel of the circular recency list, followed
+     * by the most and preceded by the least recently used */
+    lru_node head;
+    /* function called on evicted bindings and its context */
+    EvictFunc evict;
+    void *ctx;
+
+} lru;
+
+
+/* take node out of recency list */
+static inline void
+unlink_node (lru_node *n)
+{
+
+    n->prev->next = n->next;
+    n->next->prev = n->prev;
+
+}
+
+
+/* put node in front of recency list as most recently used */
+static inline void
+push_front (lru *cache, lru_node *n)
+{
+
+    n->prev = &cache->head;
+    n->next = cache->head.next;
+
+    cache->head.next->prev = n;
+    cache->head.next = n;
+
+}
+
+
+/* mark node as used, moving it to the front unless in clock mode */
+static inline void
+touch (lru *cache, lru_node *n)
+{
+
+    if (cache->flags & LRU_CLOCK) {
+        n->referenced = 1;
+
+        return;
+    }
+
+    unlink_node (n);
+    push_front (cache, n);
+
+}
+
+
+/* remove least recently used binding, in clock mode
+ * giving used ones a second chance at the front first */
+static void
+evict (lru *cache)
+{
+
+    lru_node *victim = cache->head.prev;
+
+    while (victim->referenced) {
+        victim->referenced = 0;
+
+        unlink_node (victim);
+        push_front (cache, victim);
+
+        victim = cache->head.prev;
+    }
+
+    unlink_node (victim);
+    map_remove_n (cache->map, victim->key, victim->len);
+
+    if (cache->evict)
+        cache->evict (victim->key, victim->len, victim->value, cache->ctx);
+
+    free (victim);
+
+    --cache->load;
+
+}
+
+
+/* initialize lru cache */
+int
+lru_init (Lru *c, size_t capacity)
+{
+
+    return lru_init_with_policy (c, capacity, 0, NULL, NULL);
+
+}
+
+
+/* initialize lru cache with given policy flags and eviction function */
+int
+lru_init_with_policy (Lru *c, size_t capacity, int flags, EvictFunc evict, void *ctx)
+{
+
+    int ret;
+
+    lru *cache;
+
+    if (!capacity)
+        return MAP_INVALID_ARGUMENT;
+
+    cache = malloc (sizeof (lru));
+
+    if (!cache)
+        return MAP_OUT_OF_MEMORY;
+
+    // room for a new binding before the evicted one is removed
+    ret = map_init_with_capacity (&cache->map, capacity + 1);
+
+    if (ret != MAP_OK) {
+        // free previously allocated resources
+        free (cache);
+
+        return ret;
+    }
+
+    cache->load = 0;
+    cache->capacity = capacity;
+    cache->flags = flags;
+    cache->head.prev = &cache->head;
+    cache->head.next = &cache->head;
+    cache->evict = evict;
+    cache->ctx = ctx;
+
+    *c = cache;
+
+    return MAP_OK;
+
+}
+
+
+/* delete lru cache */
+int
+lru_free (Lru c)
+{
+
+    lru_node *n, *next;
+
+    lru *cache = c;
+
+    if (!cache)
+        return MAP_INVALID;
+
+    for (n = cache->head.next; n != &cache->head; n = next) {
+        next = n->next;
+
+        if (cache->evict)
+            cache->evict (n->key, n->len, n->value, cache->ctx);
+
+        free (n);
+    }
+
+    map_free (cache->map);
+    free (cache);
+
+    return MAP_OK;
+
+}
+
+
+/* retreive value of given key from lru cache */
+int
+lru_get (Lru c, const Key key, Any *value)
+{
+
+    return lru_get_n (c, key, strlen (key), value);
+
+}
+
+
+/* retreive value of given key of given length from lru cache */
+int
+lru_get_n (Lru c, const void *key, size_t len, Any *value)
+{
+
+    int ret;
+
+    Any n;
+
+    lru *cache = c;
+
+    if (!cache)
+        return MAP_INVALID;
+
+    ret = map_lookup_n (cache->map, key, len, &n);
+
+    if (ret != MAP_OK) {
+        *value = NULL;
+
+        return ret;
+    }
+
+    touch (cache, n);
+
+    // retreive value
+    *value = ((lru_node *) n)->value;
+
+    return MAP_OK;
+
+}
+
+
+/* update key or create new binding if not exists */
+int
+lru_put (Lru c, const Key key, const Any value)
+{
+
+    return lru_put_n (c, key, strlen (key), value);
+
+}
+
+
+/* update key of given length or create new binding if not exists,
+ * the key is hashed once for the lookup and the insert on a miss,
+ * and a node holding its copy only allocated on a miss */
+int
+lru_put_n (Lru c, const void *key, size_t len, const Any value)
+{
+
+    int ret;
+
+    uint64_t h;
+
+    Any found;
+    lru_node *n;
+
+    lru *cache = c;
+
+    if (!cache)
+        return MAP_INVALID;
+
+    h = map_hash_key (cache->map, key, len);
+
+    // update value of existing binding
+    if (map_lookup_hashed (cache->map, key, len, h, &found) == MAP_OK) {
+        n = found;
+        n->value = value;
+
+        touch (cache, n);
+
+        return MAP_OK;
+    }
+
+    n = malloc (sizeof (lru_node) + len + 1);
+
+    if (!n)
+        return MAP_OUT_OF_MEMORY;
+
+    n->key = (char *) (n + 1);
+    n->len = len;
+    n->value = value;
+    n->referenced = 0;
+
+    memcpy (n->key, key, len);
+    n->key[len] = '\0';
+
+    ret = map_insert_hashed (cache->map, n->key, len, h, n);
+
+    if (ret != MAP_OK) {
+        // free previously allocated resources
+        free (n);
+
+        return ret;
+    }
+
+    // make room before the new binding enters the recency list
+    if (cache->load == cache->capacity)
+        evict (cache);
+
+    push_front (cache, n);
+
+    ++cache->load;
+
+    return MAP_OK;
+
+}
+
+
+/* remove binding from lru cache */
+int
+lru_remove (Lru c, const Key key)
+{
+
+    return lru_remove_n (c, key, strlen (key));
+
+}
+
+
+/* remove binding with key of given length from lru cache */
+int
+lru_remove_n (Lru c, const void *key, size_t len)
+{
+
+    int ret;
+
+    Any n;
+
+    lru *cache = c;
+
+    if (!cache)
+        return MAP_INVALID;
+
+    // unbind key and retreive its node in a single probe
+    ret = map_remove_hashed (cache->map, key, len, map_hash_key (cache->map, key, len), &n);
+
+    if (ret != MAP_OK)
+        return ret;
+
+    unlink_node (n);
+    free (n);
+
+    --cache->load;
+
+    return MAP_OK;
+
+}
+
+
+/* test if lru cache contains binding with given key */
+int
+lru_contains (const Lru c, const Key key)
+{
+
+    return lru_contains_n (c, key, strlen (key));
+
+}
+
+
+/* test if lru cache contains binding with given key of given length */
+int
+lru_contains_n (const Lru c, const void *key, size_t len)
+{
+
+    lru *cache = c;
+
+    if (!cache)
+        return MAP_INVALID;
+
+    return map_contains_n (cache->map, key, len);
+
+}
+
+
+/* retreive current count of bindings from lru cache */
+int
+lru_count (const Lru c, size_t *count)
+{
+
+    lru *cache = c;
+
+    if (!cache)
+        return MAP_INVALID;
+
+    *count = cache->load;
+
+    return MAP_OK;
+
+}
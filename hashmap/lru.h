@@ -0,0 +1,90 @@
+/**
+ * lru.h
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#ifndef LRU_H
+#define LRU_H
+
+
+#include <stddef.h>
+
+#include "hashmap.h"
+
+
+/* evict by second chance, hits only mark bindings instead of moving them */
+#define LRU_CLOCK                 0x01
+
+
+/* pointer to the internally managed lru cache datastructure */
+typedef void *Lru;
+
+/* function called on each binding evicted from the cache with a context pointer */
+typedef void (*EvictFunc) (const void *key, size_t len, Any value, void *ctx);
+
+
+/* initialize lru cache holding up to given count of bindings */
+extern int lru_init (Lru *c, size_t capacity);
+
+/* initialize lru cache with given policy flags and function called on evicted bindings, NULL for none */
+extern int lru_init_with_policy (Lru *c, size_t capacity, int flags, EvictFunc evict, void *ctx);
+
+/* delete lru cache, handing remaining bindings to the eviction function */
+extern int lru_free (Lru c);
+
+/* retreive value from lru cache, marking it as recently used */
+extern int lru_get (Lru c, const Key key, Any *value);
+
+/* update key or create new binding, evicting the least recently used one if full */
+extern int lru_put (Lru c, const Key key, const Any value);
+
+/* remove binding from lru cache */
+extern int lru_remove (Lru c, const Key key);
+
+/* test if lru cache contains binding with given key, without marking it as used */
+extern int lru_contains (const Lru c, const Key key);
+
+/* retreive value of binary key of given length from lru cache */
+extern int lru_get_n (Lru c, const void *key, size_t len, Any *value);
+
+/* update binary key of given length or create new binding */
+extern int lru_put_n (Lru c, const void *key, size_t len, const Any value);
+
+/* remove binding with binary key of given length from lru cache */
+extern int lru_remove_n (Lru c, const void *key, size_t len);
+
+/* test if lru cache contains binding with binary key of given length */
+extern int lru_contains_n (const Lru c, const void *key, size_t len);
+
+/* retreive current count of bindings from lru cache */
+extern int lru_count (const Lru c, size_t *count);
+
+
+#endif
@@ -0,0 +1,391 @@
+/**
+ * shardmap.c
+ *
+ * implementation of a thread safe hashmap partitioned into shards,
+ * each a hashmap of its own guarded by a reader writer lock.
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashed.h"
+#include "shardmap.h"
+
+
+/* shard count unless given on initialization, rounded up to power of two */
+#define DEFAULT_SHARDS                  64
+
+/* largest shard count, rounded down to power of two */
+#define MAX_SHARDS                      (1 << 16)
+
+/* size of a cache line, shards are padded to it to
+ * keep locks of neighbouring shards from false sharing */
+#define CACHE_LINE                      64
+
+
+typedef struct {
+    /* guards map, shared for lookups and exclusive for updates */
+    pthread_rwlock_t lock;
+    /* hashmap holding the bindings of the shard */
+    Hashmap map;
+
+} shard;
+
+
+typedef union {
+    shard s;
+    /* round shard up to whole cache lines */
+    char pad[(sizeof (shard) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE];
+
+} padded_shard;
+
+
+typedef struct {
+    /* shard count, power of two */
+    size_t count;
+    /* shift taking the shard index from the top bits of the hash */
+    int shift;
+    /* shards */
+    padded_shard *shards;
+
+} shardmap;
+
+
+/* shard responsible for key with given hash, picked by its top bits, which
+ * the hashmaps of the shards, all hashing alike, take neither the tag nor the
+ * slot from unless their tables have more slots than the hash has bits left */
+static inline shard *
+shard_of (const shardmap *map, uint64_t h)
+{
+
+    if (map->count == 1)
+        return &map->shards[0].s;
+
+    return &map->shards[h >> map->shift].s;
+
+}
+
+
+/* delete given count of shards */
+static void
+free_shards (shardmap *map, size_t count)
+{
+
+    size_t i;
+
+    for (i = 0; i < count; ++i) {
+
+        pthread_rwlock_destroy (&map->shards[i].s.lock);
+        map_free (map->shards[i].s.map);
+
+    }
+
+    free (map->shards);
+
+}
+
+
+/* initialize sharded hashmap */
+int
+shardmap_init (Shardmap *sm, size_t shards, int flags)
+{
+
+    int ret;
+
+    size_t i;
+
+    void *mem;
+
+    uint64_t seed;
+
+    shardmap *map;
+
+    // lookups under shared lock must not migrate bindings
+    if (flags & MAP_INCREMENTAL)
+        return MAP_INVALID_ARGUMENT;
+
+    map = malloc (sizeof (shardmap));
+
+    if (!map)
+        return MAP_OUT_OF_MEMORY;
+
+    if (!shards)
+        shards = DEFAULT_SHARDS;
+
+    if (shards > MAX_SHARDS)
+        shards = MAX_SHARDS;
+
+    for (map->count = 1, map->shift = 64; map->count < shards; map->count <<= 1, --map->shift);
+
+    if (posix_memalign (&mem, CACHE_LINE, map->count * sizeof (padded_shard))) {
+        // free previously allocated resources
+        free (map);
+
+        return MAP_OUT_OF_MEMORY;
+    }
+
+    map->shards = mem;
+
+    // shards share one seed so that a key hashed once serves all of them
+    seed = map_random_seed ();
+
+    for (i = 0; i < map->count; ++i) {
+
+        ret = map_init_with_hash (&map->shards[i].s.map, flags, NULL, seed);
+
+        if (ret == MAP_OK && pthread_rwlock_init (&map->shards[i].s.lock, NULL)) {
+            map_free (map->shards[i].s.map);
+
+            ret = MAP_OUT_OF_MEMORY;
+        }
+
+        if (ret != MAP_OK) {
+            // free previously allocated resources
+            free_shards (map, i);
+            free (map);
+
+            return ret;
+        }
+    }
+
+    *sm = map;
+
+    return MAP_OK;
+
+}
+
+
+/* delete sharded hashmap */
+int
+shardmap_free (Shardmap sm)
+{
+
+    shardmap *map = sm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    free_shards (map, map->count);
+    free (map);
+
+    return MAP_OK;
+
+}
+
+
+/* retreive value of given key from sharded hashmap */
+int
+shardmap_lookup (const Shardmap sm, const Key key, Any *value)
+{
+
+    return shardmap_lookup_n (sm, key, strlen (key), value);
+
+}
+
+
+/* retreive value of given key of given length from sharded hashmap */
+int
+shardmap_lookup_n (const Shardmap sm, const void *key, size_t len, Any *value)
+{
+
+    int ret;
+
+    uint64_t h;
+
+    shard *s;
+
+    shardmap *map = sm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    // key is hashed once for the shard and its hashmap
+    h = map_hash_key (map->shards[0].s.map, key, len);
+    s = shard_of (map, h);
+
+    pthread_rwlock_rdlock (&s->lock);
+    ret = map_lookup_hashed (s->map, key, len, h, value);
+    pthread_rwlock_unlock (&s->lock);
+
+    return ret;
+
+}
+
+
+/* update key or create new binding if not exists */
+int
+shardmap_insert (Shardmap sm, const Key key, const Any value)
+{
+
+    return shardmap_insert_n (sm, key, strlen (key), value);
+
+}
+
+
+/* update key of given length or create new binding if not exists,
+ * a resize only blocks the shard of the key */
+int
+shardmap_insert_n (Shardmap sm, const void *key, size_t len, const Any value)
+{
+
+    int ret;
+
+    uint64_t h;
+
+    shard *s;
+
+    shardmap *map = sm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    // key is hashed once for the shard and its hashmap
+    h = map_hash_key (map->shards[0].s.map, key, len);
+    s = shard_of (map, h);
+
+    pthread_rwlock_wrlock (&s->lock);
+    ret = map_insert_hashed (s->map, key, len, h, value);
+    pthread_rwlock_unlock (&s->lock);
+
+    return ret;
+
+}
+
+
+/* remove binding from sharded hashmap */
+int
+shardmap_remove (Shardmap sm, const Key key)
+{
+
+    return shardmap_remove_n (sm, key, strlen (key));
+
+}
+
+
+/* remove binding with key of given length from sharded hashmap */
+int
+shardmap_remove_n (Shardmap sm, const void *key, size_t len)
+{
+
+    int ret;
+
+    uint64_t h;
+
+    shard *s;
+
+    shardmap *map = sm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    // key is hashed once for the shard and its hashmap
+    h = map_hash_key (map->shards[0].s.map, key, len);
+    s = shard_of (map, h);
+
+    pthread_rwlock_wrlock (&s->lock);
+    ret = map_remove_hashed (s->map, key, len, h, NULL);
+    pthread_rwlock_unlock (&s->lock);
+
+    return ret;
+
+}
+
+
+/* test if sharded hashmap contains binding with given key */
+int
+shardmap_contains (const Shardmap sm, const Key key)
+{
+
+    return shardmap_contains_n (sm, key, strlen (key));
+
+}
+
+
+/* test if sharded hashmap contains binding with given key of given length */
+int
+shardmap_contains_n (const Shardmap sm, const void *key, size_t len)
+{
+
+    int ret;
+
+    uint64_t h;
+
+    shard *s;
+
+    shardmap *map = sm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    // key is hashed once for the shard and its hashmap
+    h = map_hash_key (map->shards[0].s.map, key, len);
+    s = shard_of (map, h);
+
+    pthread_rwlock_rdlock (&s->lock);
+    ret = map_contains_hashed (s->map, key, len, h);
+    pthread_rwlock_unlock (&s->lock);
+
+    return ret;
+
+}
+
+
+/* retreive current count of bindings from sharded hashmap, shards
+ * are counted one after another while others may change */
+int
+shardmap_count (const Shardmap sm, size_t *count)
+{
+
+    size_t i, n;
+
+    shardmap *map = sm;
+
+    if (!map)
+        return MAP_INVALID;
+
+    *count = 0;
+
+    for (i = 0; i < map->count; ++i) {
+
+        pthread_rwlock_rdlock (&map->shards[i].s.lock);
+        map_count (map->shards[i].s.map, &n);
+        pthread_rwlock_unlock (&map->shards[i].s.lock);
+
+        *count += n;
+
+    }
+
+    return MAP_OK;
+
+}
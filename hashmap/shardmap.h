@@ -0,0 +1,81 @@
+/**
+ * shardmap.h
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+#ifndef SHARDMAP_H
+#define SHARDMAP_H
+
+
+#include <stddef.h>
+
+#include "hashmap.h"
+
+
+/* pointer to the internally managed sharded hashmap datastructure */
+typedef void *Shardmap;
+
+
+/* initialize sharded hashmap with given count of shards, 0 for default,
+ * and mode flags of the hashmap in each shard except MAP_INCREMENTAL */
+extern int shardmap_init (Shardmap *sm, size_t shards, int flags);
+
+/* delete sharded hashmap */
+extern int shardmap_free (Shardmap sm);
+
+/* retreive value from sharded hashmap */
+extern int shardmap_lookup (const Shardmap sm, const Key key, Any *value);
+
+/* update key or create new binding if not exists */
+extern int shardmap_insert (Shardmap sm, const Key key, const Any value);
+
+/* remove binding from sharded hashmap */
+extern int shardmap_remove (Shardmap sm, const Key key);
+
+/* test if sharded hashmap contains binding with given key */
+extern int shardmap_contains (const Shardmap sm, const Key key);
+
+/* retreive value from sharded hashmap by binary key of given length */
+extern int shardmap_lookup_n (const Shardmap sm, const void *key, size_t len, Any *value);
+
+/* update binary key of given length or create new binding if not exists */
+extern int shardmap_insert_n (Shardmap sm, const void *key, size_t len, const Any value);
+
+/* remove binding with binary key of given length from sharded hashmap */
+extern int shardmap_remove_n (Shardmap sm, const void *key, size_t len);
+
+/* test if sharded hashmap contains binding with binary key of given length */
+extern int shardmap_contains_n (const Shardmap sm, const void *key, size_t len);
+
+/* retreive current count of bindings from sharded hashmap */
+extern int shardmap_count (const Shardmap sm, size_t *count);
+
+
+#endif
@@ -0,0 +1,562 @@
+/**
+ * test.c
+ *
+ * differential tests of the hashmaps against a reference map.
+ *
+ * Copyright (c) 2019, Tobias Heilig
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the authors may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashmap.h"
+#include "hashset.h"
+#include "intmap.h"
+#include "lru.h"
+#include "shardmap.h"
+
+
+/* distinct keys drawn by the tests */
+#define KEY_COUNT       1024
+
+/* operations per hashmap and between comparisons of all bindings */
+#define OP_COUNT        8192
+#define CHECK_EVERY     512
+
+/* modes whose combinations are tested */
+#define FLAG_MASK       (MAP_ROBIN_HOOD | MAP_POW2 | MAP_FIBONACCI | MAP_INCREMENTAL | MAP_OWN_KEYS \
+                         | MAP_CONCURRENT_READS | MAP_QUADRATIC | MAP_TRIANGULAR | MAP_COMPACT | MAP_SMALL)
+
+
+/* reference map, binding key of index to value if present */
+typedef struct {
+    int present[KEY_COUNT];
+    intptr_t value[KEY_COUNT];
+    size_t count;
+
+} reference;
+
+
+/* keys of distinct lengths, each a run of letters followed by its index */
+static char keys[KEY_COUNT][40];
+static size_t lens[KEY_COUNT];
+
+static uint64_t state = 0x9e3779b97f4a7c15;
+
+
+/* next pseudo random number */
+static uint64_t
+rnd (void)
+{
+
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    return state;
+
+}
+
+
+/* fill keys */
+static void
+make_keys (void)
+{
+
+    size_t i;
+
+    for (i = 0; i < KEY_COUNT; ++i)
+        lens[i] = (size_t) sprintf (keys[i], "%.*s%zu", (int) (i % 27), "abcdefghijklmnopqrstuvwxyz_", i);
+
+}
+
+
+/* index of key, parsed from the digits it ends in */
+static size_t
+index_of (const void *key, size_t len)
+{
+
+    const char *k = key;
+
+    size_t i = 0, n = 0;
+
+    for (; i < len && (k[i] < '0' || k[i] > '9'); ++i);
+
+    for (; i < len; ++i)
+        n = n * 10 + (size_t) (k[i] - '0');
+
+    assert (n < KEY_COUNT && len == lens[n] && !memcmp (key, keys[n], len));
+
+    return n;
+
+}
+
+
+/* hash crowding all keys onto a few home slots and tags */
+static uint64_t
+crowded_hash (const void *key, size_t len, uint64_t seed)
+{
+
+    return map_hash_wyhash (key, len, seed) & 0xe00000000000000f;
+
+}
+
+
+/* add one to value */
+static void
+count_one (Any *value, int inserted, void *ctx)
+{
+
+    *value = inserted ? (Any) 1 : (Any) ((intptr_t) *value + 1);
+
+}
+
+
+/* compare all bindings of hashmap with reference */
+static void
+check_map (Hashmap map, const reference *ref)
+{
+
+    size_t i, n, len;
+
+    const void *key;
+
+    Any value;
+
+    Iterator it;
+
+    int seen[KEY_COUNT] = { 0 };
+
+    assert (map_count (map, &n) == MAP_OK && n == ref->count);
+
+    for (i = 0; i < KEY_COUNT; ++i) {
+
+        if (ref->present[i]) {
+            assert (map_lookup_n (map, keys[i], lens[i], &value) == MAP_OK);
+            assert ((intptr_t) value == ref->value[i]);
+            assert (map_contains_n (map, keys[i], lens[i]) == MAP_OK);
+        } else {
+            assert (map_lookup_n (map, keys[i], lens[i], &value) == MAP_KEY_NOT_FOUND);
+            assert (map_contains_n (map, keys[i], lens[i]) == MAP_KEY_NOT_FOUND);
+        }
+    }
+
+    assert (map_iter_init (&it, map) == MAP_OK);
+
+    for (n = 0; map_iter_has_next (it) == MAP_OK; ++n) {
+
+        assert (map_iter_next_n (it, &key, &len, &value) == MAP_OK);
+
+        i = index_of (key, len);
+
+        assert (ref->present[i] && !seen[i] && (intptr_t) value == ref->value[i]);
+
+        seen[i] = 1;
+
+    }
+
+    assert (n == ref->count);
+
+    map_iter_free (it);
+
+}
+
+
+/* run remove heavy churn on hashmap of given mode, growing it toward
+ * all keys and draining it again in turns, and compare it with the
+ * reference all along, false if the mode is not supported */
+static int
+test_map (int flags, HashFunc hash)
+{
+
+    int ret, inserted;
+
+    size_t i, k, op;
+
+    Any *slot;
+
+    Hashmap map;
+
+    reference ref = { { 0 }, { 0 }, 0 };
+
+    ret = map_init_with_hash (&map, flags, hash, rnd ());
+
+    if (ret == MAP_INVALID_ARGUMENT)
+        return 0;
+
+    assert (ret == MAP_OK);
+
+    for (i = 0; i < OP_COUNT; ++i) {
+
+        k = rnd () % KEY_COUNT;
+        op = rnd () % 16;
+
+        // removals outweigh insertions in every other quarter
+        if ((i / (OP_COUNT / 4)) & 1)
+            op = op < 4 ? op : op + 6;
+
+        // entries are handed out only without concurrent readers
+        if (op >= 6 && op < 8 && (flags & MAP_CONCURRENT_READS))
+            op = 0;
+
+        if (op < 6) {
+            assert (map_insert_n (map, keys[k], lens[k], (Any) (intptr_t) i) == MAP_OK);
+
+            ref.count += !ref.present[k];
+            ref.present[k] = 1;
+            ref.value[k] = (intptr_t) i;
+        } else if (op < 8) {
+            assert (map_entry_n (map, keys[k], lens[k], &slot, &inserted) == MAP_OK);
+            assert (inserted == !ref.present[k]);
+
+            *slot = (Any) (intptr_t) i;
+
+            ref.count += !ref.present[k];
+            ref.present[k] = 1;
+            ref.value[k] = (intptr_t) i;
+        } else if (op < 10) {
+            assert (map_upsert_n (map, keys[k], lens[k], count_one, NULL) == MAP_OK);
+
+            ref.count += !ref.present[k];
+            ref.value[k] = ref.present[k] ? ref.value[k] + 1 : 1;
+            ref.present[k] = 1;
+        } else {
+            assert (map_remove_n (map, keys[k], lens[k]) == (ref.present[k] ? MAP_OK : MAP_KEY_NOT_FOUND));
+
+            ref.count -= ref.present[k];
+            ref.present[k] = 0;
+        }
+
+        if (i % CHECK_EVERY == CHECK_EVERY - 1)
+            check_map (map, &ref);
+
+        // resize out of turn now and then
+        if (i % (OP_COUNT / 4) == OP_COUNT / 8) {
+            assert (map_shrink_to_fit (map) == MAP_OK);
+            check_map (map, &ref);
+            assert (map_reserve (map, KEY_COUNT) == MAP_OK);
+            check_map (map, &ref);
+        }
+    }
+
+    assert (map_clear (map) == MAP_OK);
+
+    memset (&ref, 0, sizeof (ref));
+
+    check_map (map, &ref);
+
+    map_free (map);
+
+    return 1;
+
+}
+
+
+/* test hashmaps of all combinations of modes */
+static void
+test_maps (void)
+{
+
+    int flags;
+
+    size_t modes = 0;
+
+    for (flags = 0; flags <= FLAG_MASK; ++flags) {
+
+        if ((flags & FLAG_MASK) != flags)
+            continue;
+
+        modes += test_map (flags, NULL);
+        test_map (flags, crowded_hash);
+
+    }
+
+    assert (test_map (MAP_SIPHASH, NULL) && test_map (MAP_SIPHASH | MAP_ROBIN_HOOD | MAP_COMPACT, NULL));
+
+    printf ("hashmap   %zu modes\n", modes);
+
+}
+
+
+/* run remove heavy churn on set against reference */
+static void
+test_set (void)
+{
+
+    size_t i, k, n;
+
+    const void *key;
+
+    Iterator it;
+
+    Hashset set;
+
+    reference ref = { { 0 }, { 0 }, 0 };
+
+    assert (set_init (&set) == MAP_OK);
+
+    for (i = 0; i < OP_COUNT * 8; ++i) {
+
+        k = rnd () % KEY_COUNT;
+
+        if (rnd () % 16 < ((i / OP_COUNT) & 1 ? 5 : 10)) {
+            assert (set_insert_n (set, keys[k], lens[k]) == MAP_OK);
+
+            ref.count += !ref.present[k];
+            ref.present[k] = 1;
+        } else {
+            assert (set_remove_n (set, keys[k], lens[k]) == (ref.present[k] ? MAP_OK : MAP_KEY_NOT_FOUND));
+
+            ref.count -= ref.present[k];
+            ref.present[k] = 0;
+        }
+
+        if (i % CHECK_EVERY)
+            continue;
+
+        assert (set_count (set, &n) == MAP_OK && n == ref.count);
+
+        for (k = 0; k < KEY_COUNT; ++k)
+            assert (set_contains_n (set, keys[k], lens[k]) == (ref.present[k] ? MAP_OK : MAP_KEY_NOT_FOUND));
+
+        assert (set_iter_init (&it, set) == MAP_OK);
+
+        for (n = 0; set_iter_has_next (it) == MAP_OK; ++n) {
+            assert (set_iter_next_n (it, &key, &k) == MAP_OK);
+            assert (ref.present[index_of (key, k)]);
+        }
+
+        assert (n == ref.count);
+
+        set_iter_free (it);
+    }
+
+    set_free (set);
+
+    printf ("hashset   ok\n");
+
+}
+
+
+/* run remove heavy churn on integer keyed hashmap against reference */
+static void
+test_intmap (void)
+{
+
+    size_t i, k, n;
+
+    uint64_t key;
+
+    Any value;
+
+    Iterator it;
+
+    Intmap map;
+
+    reference ref = { { 0 }, { 0 }, 0 };
+
+    assert (intmap_init (&map) == MAP_OK);
+
+    for (i = 0; i < OP_COUNT * 8; ++i) {
+
+        k = rnd () % KEY_COUNT;
+
+        if (rnd () % 16 < ((i / OP_COUNT) & 1 ? 5 : 10)) {
+            // keys differing in high bits only
+            assert (intmap_insert (map, (uint64_t) k << 48, (Any) (intptr_t) i) == MAP_OK);
+
+            ref.count += !ref.present[k];
+            ref.present[k] = 1;
+            ref.value[k] = (intptr_t) i;
+        } else {
+            assert (intmap_remove (map, (uint64_t) k << 48) == (ref.present[k] ? MAP_OK : MAP_KEY_NOT_FOUND));
+
+            ref.count -= ref.present[k];
+            ref.present[k] = 0;
+        }
+
+        if (i % CHECK_EVERY)
+            continue;
+
+        assert (intmap_count (map, &n) == MAP_OK && n == ref.count);
+
+        for (k = 0; k < KEY_COUNT; ++k) {
+
+            if (ref.present[k])
+                assert (intmap_lookup (map, (uint64_t) k << 48, &value) == MAP_OK && (intptr_t) value == ref.value[k]);
+            else
+                assert (intmap_lookup (map, (uint64_t) k << 48, &value) == MAP_KEY_NOT_FOUND);
+
+        }
+
+        assert (intmap_iter_init (&it, map) == MAP_OK);
+
+        for (n = 0; intmap_iter_has_next (it) == MAP_OK; ++n) {
+            assert (intmap_iter_next (it, &key, &value) == MAP_OK);
+            assert (key >> 48 < KEY_COUNT && ref.present[key >> 48] && (intptr_t) value == ref.value[key >> 48]);
+        }
+
+        assert (n == ref.count);
+
+        intmap_iter_free (it);
+    }
+
+    intmap_free (map);
+
+    printf ("intmap    ok\n");
+
+}
+
+
+/* run remove heavy churn on sharded hashmap against reference */
+static void
+test_shardmap (void)
+{
+
+    size_t i, k;
+
+    Any value;
+
+    Shardmap map;
+
+    reference ref = { { 0 }, { 0 }, 0 };
+
+    assert (shardmap_init (&map, 8, MAP_ROBIN_HOOD) == MAP_OK);
+
+    for (i = 0; i < OP_COUNT * 4; ++i) {
+
+        k = rnd () % KEY_COUNT;
+
+        if (rnd () % 16 < ((i / OP_COUNT) & 1 ? 5 : 10)) {
+            assert (shardmap_insert_n (map, keys[k], lens[k], (Any) (intptr_t) i) == MAP_OK);
+
+            ref.present[k] = 1;
+            ref.value[k] = (intptr_t) i;
+        } else {
+            assert (shardmap_remove_n (map, keys[k], lens[k]) == (ref.present[k] ? MAP_OK : MAP_KEY_NOT_FOUND));
+
+            ref.present[k] = 0;
+        }
+
+        k = rnd () % KEY_COUNT;
+
+        if (ref.present[k])
+            assert (shardmap_lookup_n (map, keys[k], lens[k], &value) == MAP_OK && (intptr_t) value == ref.value[k]);
+        else
+            assert (shardmap_contains_n (map, keys[k], lens[k]) == MAP_KEY_NOT_FOUND);
+
+    }
+
+    shardmap_free (map);
+
+    printf ("shardmap  ok\n");
+
+}
+
+
+/* run churn on lru cache against reference, with capacity above key count
+ * so that nothing is evicted, and below it so that the count stays bounded */
+static void
+test_lru (void)
+{
+
+    size_t i, k, n, capacity;
+
+    Any value;
+
+    Lru cache;
+
+    reference ref = { { 0 }, { 0 }, 0 };
+
+    for (capacity = KEY_COUNT; capacity >= KEY_COUNT / 8; capacity /= 8) {
+
+        assert (lru_init (&cache, capacity) == MAP_OK);
+
+        memset (&ref, 0, sizeof (ref));
+
+        for (i = 0; i < OP_COUNT * 4; ++i) {
+
+            k = rnd () % KEY_COUNT;
+
+            if (rnd () % 16 < ((i / OP_COUNT) & 1 ? 5 : 10)) {
+                assert (lru_put_n (cache, keys[k], lens[k], (Any) (intptr_t) i) == MAP_OK);
+                assert (lru_get_n (cache, keys[k], lens[k], &value) == MAP_OK && (intptr_t) value == (intptr_t) i);
+
+                ref.present[k] = 1;
+                ref.value[k] = (intptr_t) i;
+            } else if (capacity == KEY_COUNT) {
+                assert (lru_remove_n (cache, keys[k], lens[k]) == (ref.present[k] ? MAP_OK : MAP_KEY_NOT_FOUND));
+
+                ref.present[k] = 0;
+            } else {
+                lru_remove_n (cache, keys[k], lens[k]);
+
+                assert (lru_contains_n (cache, keys[k], lens[k]) == MAP_KEY_NOT_FOUND);
+            }
+
+            assert (lru_count (cache, &n) == MAP_OK && n <= capacity);
+
+            // without evictions the cache agrees with the reference
+            if (capacity == KEY_COUNT) {
+                k = rnd () % KEY_COUNT;
+
+                if (ref.present[k])
+                    assert (lru_get_n (cache, keys[k], lens[k], &value) == MAP_OK && (intptr_t) value == ref.value[k]);
+                else
+                    assert (lru_contains_n (cache, keys[k], lens[k]) == MAP_KEY_NOT_FOUND);
+            }
+        }
+
+        lru_free (cache);
+    }
+
+    printf ("lru       ok\n");
+
+}
+
+
+int
+main (void)
+{
+
+    make_keys ();
+
+    test_maps ();
+    test_set ();
+    test_intmap ();
+    test_shardmap ();
+    test_lru ();
+
+    return EXIT_SUCCESS;
+
+}